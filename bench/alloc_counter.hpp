@@ -0,0 +1,18 @@
+//
+// Created by Supradeep Chitumalla
+//
+// Counts heap allocations made by any thread. alloc_counter.cpp replaces the
+// global operator new and delete; link it into every bench that includes this.
+
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace deribit {
+
+    std::atomic<uint64_t>& heap_allocations();
+}
+
+#endif //ALLOC_COUNTER_H
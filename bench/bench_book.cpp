@@ -0,0 +1,219 @@
+//
+// Created by Supradeep Chitumalla
+//
+// The book engine in isolation: decoding book.* frames into BookUpdates,
+// and applying them to books with MarketData::parse_orderbook_update /
+// apply_incremental_update, with no queue, sequencing, publishing or
+// callback around them. Each corpus is replayed as fast as possible:
+//
+//   decode      frame -> BookUpdate (BookDecoder), warm
+//   apply-cold  the first pass over fresh books: ladders and pools growing
+//   apply       further passes over the same books, i.e. steady state
+//
+// and reported per update as ns, heap allocations and, where perf_event is
+// permitted, cycles, instructions, last-level cache misses and L1D read
+// misses.
+//
+// Corpora are recordings made with menu option 10 (book.*.100ms or
+// book.*.raw, any mix of instruments) plus two generated ones: "synthetic",
+// churn close to the touch as on a liquid perpetual, and "synthetic-deep",
+// 2000 levels a side with changes spread deep into the book and a mid that
+// moves often, which is hard on the ladder window.
+//
+// usage: bench_book [recording.rec ...] [--passes N] [--no-synthetic]
+
+#include "alloc_counter.hpp"
+#include "book_decoder.hpp"
+#include "feed_recorder.hpp"
+#include "market_data.hpp"
+#include "perf_counters.hpp"
+#include "synthetic_feed.hpp"
+#include "tsc_clock.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using namespace deribit;
+
+namespace {
+
+    struct Corpus {
+        std::string name;
+        std::vector<RecordedFrame> frames;
+    };
+
+    struct PhaseResult {
+        size_t updates = 0;
+        int64_t ns = 0;
+        uint64_t allocs = 0;
+        std::array<uint64_t, kPerfCounterCount> counters{};
+    };
+
+    // A book laid out as MarketData lays out its own (levels from a pool).
+    struct Book {
+        std::pmr::unsynchronized_pool_resource pool;
+        Orderbook ob{&pool};
+    };
+
+    volatile double sink;
+
+    template<typename Fn>
+    PhaseResult measure(PerfCounters& perf, size_t updates, Fn&& body) {
+        PhaseResult r;
+        r.updates = updates;
+        uint64_t allocs = heap_allocations().load();
+        perf.start();
+        int64_t start = TscClock::now();
+        body();
+        int64_t end = TscClock::now();
+        perf.stop();
+        r.allocs = heap_allocations().load() - allocs;
+        r.ns = TscClock::to_ns(end - start);
+        for (size_t i = 0; i < kPerfCounterCount; ++i) {
+            r.counters[i] = perf.value(static_cast<PerfCounter>(i));
+        }
+        return r;
+    }
+
+    void print_header() {
+        std::printf("%-20s %-10s %9s %8s %9s %10s %10s %10s %12s %12s\n", "corpus", "phase", "updates",
+                    "lvl/upd", "ns/upd", "allocs/upd", "cycles/upd", "instr/upd", "LLC-miss/upd", "L1d-miss/upd");
+    }
+
+    void print_row(const PerfCounters& perf, const std::string& corpus, const char* phase,
+                   const PhaseResult& r, double levels_per_update) {
+        double n = r.updates ? static_cast<double>(r.updates) : 1.0;
+        std::printf("%-20s %-10s %9zu %8.1f %9.1f %10.3f", corpus.c_str(), phase, r.updates, levels_per_update,
+                    static_cast<double>(r.ns) / n, static_cast<double>(r.allocs) / n);
+        for (PerfCounter c : {PerfCounter::Cycles, PerfCounter::Instructions, PerfCounter::CacheMisses,
+                              PerfCounter::L1dReadMisses}) {
+            int width = c == PerfCounter::Cycles || c == PerfCounter::Instructions ? 10 : 12;
+            if (perf.available(c)) {
+                std::printf(" %*.1f", width, static_cast<double>(r.counters[static_cast<size_t>(c)]) / n);
+            } else {
+                std::printf(" %*s", width, "n/a");
+            }
+        }
+        std::printf("\n");
+    }
+
+    void run(PerfCounters& perf, const Corpus& corpus, size_t passes) {
+        InstrumentRegistry registry;
+        for (const std::string& name : instruments_in(corpus.frames)) {
+            registry.intern(name);
+        }
+        BookDecoder decoder(&registry);
+
+        // Decoded once up front; the apply phases replay these.
+        std::vector<BookUpdate> updates;
+        size_t levels = 0;
+        BookUpdate update;
+        for (const RecordedFrame& frame : corpus.frames) {
+            if (decoder.decode(frame.payload, update) == DecodeStatus::Book &&
+                update.instrument_id != kInvalidInstrument) {
+                levels += update.bids.size() + update.asks.size();
+                updates.push_back(update);
+            }
+        }
+        if (updates.empty()) {
+            std::printf("%-20s no book messages\n", corpus.name.c_str());
+            return;
+        }
+        double levels_per_update = static_cast<double>(levels) / static_cast<double>(updates.size());
+
+        PhaseResult decode = measure(perf, updates.size() * passes, [&] {
+            for (size_t pass = 0; pass < passes; ++pass) {
+                for (const RecordedFrame& frame : corpus.frames) {
+                    decoder.decode(frame.payload, update);
+                }
+            }
+        });
+        print_row(perf, corpus.name, "decode", decode, levels_per_update);
+
+        std::vector<std::unique_ptr<Book>> books(registry.size());
+        for (size_t id = 0; id < books.size(); ++id) {
+            books[id] = std::make_unique<Book>();
+            books[id]->ob.instrument_name = registry.name(static_cast<InstrumentId>(id));
+        }
+        auto apply_all = [&] {
+            for (const BookUpdate& u : updates) {
+                Orderbook& ob = books[u.instrument_id]->ob;
+                if (u.type == BookUpdateType::Snapshot) {
+                    MarketData::parse_orderbook_update(ob, u);
+                } else {
+                    MarketData::apply_incremental_update(ob, u);
+                }
+            }
+        };
+
+        PhaseResult cold = measure(perf, updates.size(), apply_all);
+        print_row(perf, corpus.name, "apply-cold", cold, levels_per_update);
+
+        PhaseResult warm = measure(perf, updates.size() * passes, [&] {
+            for (size_t pass = 0; pass < passes; ++pass) {
+                apply_all();
+            }
+        });
+        print_row(perf, corpus.name, "apply", warm, levels_per_update);
+
+        double touch = 0.0;
+        for (const auto& book : books) {
+            touch += book->ob.best_bid_price + book->ob.best_ask_price;
+        }
+        sink = touch;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> recordings;
+    size_t passes = 5;
+    bool synthetic = true;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--passes") == 0 && i + 1 < argc) {
+            passes = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--no-synthetic") == 0) {
+            synthetic = false;
+        } else {
+            recordings.push_back(argv[i]);
+        }
+    }
+
+    std::vector<Corpus> corpora;
+    for (const std::string& path : recordings) {
+        corpora.push_back({path, load_recording(path)});
+    }
+    if (synthetic) {
+        corpora.push_back({"synthetic", SyntheticFeed().generate()});
+
+        SyntheticFeedOptions deep;
+        deep.depth = 2000;
+        deep.updates = 50000;
+        deep.levels_per_update = 20;
+        deep.touch_bias = 0.02;         // mean distance ~50 ticks from the mid
+        deep.mid_move_percent = 30;
+        corpora.push_back({"synthetic-deep", SyntheticFeed(deep).generate()});
+    }
+    if (corpora.empty()) {
+        std::fprintf(stderr, "usage: %s [recording.rec ...] [--passes N] [--no-synthetic]\n", argv[0]);
+        return 1;
+    }
+
+    TscClock::calibrate();
+    PerfCounters perf;
+    std::printf("timestamps: %s, hardware counters: %s, %zu warm passes\n\n",
+                TscClock::using_tsc() ? "invariant TSC" : "steady_clock",
+                perf.any_available() ? "perf_event" : "unavailable", passes);
+    print_header();
+    for (const Corpus& corpus : corpora) {
+        std::printf("%-20s %zu frames\n", corpus.name.c_str(), corpus.frames.size());
+        run(perf, corpus, passes);
+    }
+    return 0;
+}
@@ -0,0 +1,260 @@
+//
+// Created by Supradeep Chitumalla
+//
+// End to end over a real WebSocket: a FeedSimulator in this process streams
+// a corpus to a DeribitClient, which decodes it into MarketData as it does
+// against Deribit. For each offered load the run reports what the simulator
+// sustained, how many messages reached the strategy callback and at what
+// rate, MarketData's drop and gap counts, and send -> callback latency
+// (simulator send, socket, websocketpp, decode, queue, apply, callback).
+//
+// usage: bench_feed [recording.rec] [--rates R1,R2,...] [--burst N] [--frames N]
+//                   [--mode inline|sharded|shared] [--workers N] [--queue N]
+//                   [--tls cert.pem key.pem]
+//
+// A rate of 0 streams as fast as the socket drains, which finds saturation.
+// Each load gets a fresh connection and MarketData, because the corpus'
+// change_id chains restart with every stream. MarketData runs with
+// BackpressureMode::Drop and no resync handler: once a message is dropped
+// its instrument goes stale and stops reaching the callback, so "applied"
+// falls off sharply past the load the pipeline keeps up with.
+
+#include "deribit_client.hpp"
+#include "feed_simulator.hpp"
+#include "synthetic_feed.hpp"
+#include "tsc_clock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace deribit;
+
+namespace {
+
+    uint64_t message_key(InstrumentId id, int64_t change_id) {
+        return (static_cast<uint64_t>(id) << 48) ^ static_cast<uint64_t>(change_id);
+    }
+
+    struct LoadResult {
+        StreamResult stream;
+        size_t book_messages = 0;
+        size_t applied = 0;
+        double applied_per_second = 0.0;
+        size_t dropped = 0;
+        size_t gaps = 0;
+        std::vector<int64_t> latencies;     // ns, sorted
+    };
+
+    struct Setup {
+        RoutingMode mode = RoutingMode::Sharded;
+        size_t workers = 1;
+        size_t queue_size = 16384;
+        size_t burst = 1;
+        size_t frames = 0;
+    };
+
+    bool wait_for(const std::function<bool()>& done, int64_t timeout_ms) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (!done()) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    LoadResult run(FeedSimulator& simulator, const std::vector<std::string>& names, const Setup& setup, double rate) {
+        WaitConfig wait;
+        wait.kind = WaitKind::BusySpin;
+        MarketData md(setup.workers, setup.queue_size, setup.mode, BackpressureMode::Drop, wait);
+
+        Config config;
+        config.ws_url = simulator.url();
+        DeribitClient client(config, &md);
+        client.connect();
+        if (!wait_for([&client] { return client.is_connected(); }, 5000)) {
+            throw std::runtime_error("Could not connect to " + config.ws_url);
+        }
+        for (const std::string& name : names) {
+            client.subscribe(name);
+        }
+        if (!simulator.wait_for_subscriptions(names.size(), 5000)) {
+            throw std::runtime_error("Subscriptions were not acknowledged by the simulator");
+        }
+
+        // (instrument, change_id) -> frame, now that subscribe() has registered the books.
+        const std::vector<RecordedFrame>& frames = simulator.frames();
+        BookDecoder decoder(&md.instruments());
+        BookUpdate update;
+        std::unordered_map<uint64_t, size_t> index_of;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            if (decoder.decode(frames[i].payload, update) == DecodeStatus::Book &&
+                update.instrument_id != kInvalidInstrument) {
+                index_of[message_key(update.instrument_id, update.change_id)] = i;
+            }
+        }
+
+        // Written by the simulator's sender before the frame hits the socket,
+        // read by whichever thread runs the callback for it; TscClock ticks.
+        std::unique_ptr<std::atomic<int64_t>[]> sent(new std::atomic<int64_t>[frames.size()]());
+        std::vector<int64_t> latency(frames.size(), -1);
+        std::atomic<size_t> applied{0};
+        std::atomic<int64_t> last_applied{0};
+        const InstrumentRegistry& registry = md.instruments();
+        md.set_update_callback([&](const std::string& symbol, const Orderbook& ob) {
+            int64_t now = TscClock::now();
+            auto it = index_of.find(message_key(registry.find(symbol), ob.change_id));
+            if (it == index_of.end() || latency[it->second] >= 0) {
+                return;
+            }
+            latency[it->second] = now - sent[it->second].load(std::memory_order_relaxed);
+            applied.fetch_add(1, std::memory_order_relaxed);
+            int64_t last = last_applied.load(std::memory_order_relaxed);
+            while (last < now && !last_applied.compare_exchange_weak(last, now, std::memory_order_relaxed)) {
+            }
+        });
+
+        StreamProfile profile;
+        profile.rate = rate;
+        profile.burst = setup.burst;
+        profile.frames = setup.frames;
+        int64_t start = TscClock::now();
+        LoadResult result;
+        result.stream = simulator.stream(profile, [&sent](size_t frame, int64_t ticks) {
+            sent[frame].store(ticks, std::memory_order_relaxed);
+        });
+
+        // Until everything sent is applied, or nothing more arrives for 500 ms.
+        size_t seen = 0;
+        auto quiet_since = std::chrono::steady_clock::now();
+        while (applied.load() < result.stream.frames &&
+               std::chrono::steady_clock::now() - quiet_since < std::chrono::milliseconds(500)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            if (applied.load() != seen) {
+                seen = applied.load();
+                quiet_since = std::chrono::steady_clock::now();
+            }
+        }
+        client.disconnect();
+        wait_for([&simulator] { return simulator.subscriptions() == 0; }, 2000);
+
+        result.book_messages = result.stream.frames;
+        result.applied = applied.load();
+        int64_t span = last_applied.load() - start;
+        result.applied_per_second = span > 0
+            ? static_cast<double>(result.applied) * 1e9 / static_cast<double>(TscClock::to_ns(span)) : 0.0;
+        result.dropped = md.get_dropped_message_count();
+        result.gaps = md.get_gap_count();
+        for (int64_t l : latency) {
+            if (l >= 0) result.latencies.push_back(TscClock::to_ns(l));
+        }
+        std::sort(result.latencies.begin(), result.latencies.end());
+        return result;
+    }
+
+    int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        return sorted[static_cast<size_t>(p * static_cast<double>(sorted.size() - 1))];
+    }
+
+    std::vector<double> parse_rates(const char* list) {
+        std::vector<double> rates;
+        for (const char* p = list; *p;) {
+            char* end = nullptr;
+            double rate = std::strtod(p, &end);
+            if (end == p) break;
+            rates.push_back(rate);
+            p = *end == ',' ? end + 1 : end;
+        }
+        return rates;
+    }
+
+    bool parse_mode(const std::string& name, RoutingMode& mode) {
+        if (name == "inline") mode = RoutingMode::Inline;
+        else if (name == "sharded") mode = RoutingMode::Sharded;
+        else if (name == "shared") mode = RoutingMode::Shared;
+        else return false;
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string recording;
+    std::string mode_name = "sharded";
+    std::vector<double> rates = {10000, 50000, 100000, 200000, 0};
+    Setup setup;
+    FeedSimulatorOptions options;
+    options.port = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--rates") == 0 && i + 1 < argc) {
+            rates = parse_rates(argv[++i]);
+        } else if (std::strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+            setup.burst = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            setup.frames = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode_name = argv[++i];
+        } else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            setup.workers = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            setup.queue_size = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--tls") == 0 && i + 2 < argc) {
+            options.cert_file = argv[++i];
+            options.key_file = argv[++i];
+        } else {
+            recording = argv[i];
+        }
+    }
+    if (!parse_mode(mode_name, setup.mode) || rates.empty() ||
+        (setup.mode == RoutingMode::Shared && setup.workers > 1)) {
+        std::fprintf(stderr, "usage: %s [recording.rec] [--rates R1,R2,...] [--burst N] [--frames N] "
+                             "[--mode inline|sharded|shared] [--workers N] [--queue N] [--tls cert.pem key.pem]\n"
+                             "  (shared mode takes a single worker)\n",
+                     argv[0]);
+        return 1;
+    }
+
+    TscClock::calibrate();
+    std::vector<RecordedFrame> frames = recording.empty() ? SyntheticFeed().generate() : load_recording(recording);
+    std::vector<std::string> names = instruments_in(frames);
+    try {
+        FeedSimulator simulator(std::move(frames), options);
+        simulator.start();
+        std::printf("%s: %zu frames, %zu instruments, %s mode, %zu worker(s), %zu-slot queues, bursts of %zu\n",
+                    recording.empty() ? "synthetic feed" : recording.c_str(), simulator.frames().size(),
+                    names.size(), mode_name.c_str(), setup.workers, setup.queue_size, setup.burst);
+        std::printf("timestamps: %s\n\n", TscClock::using_tsc() ? "invariant TSC" : "steady_clock");
+
+        std::vector<std::pair<double, LoadResult>> results;
+        for (double rate : rates) {
+            results.emplace_back(rate, run(simulator, names, setup, rate));
+        }
+
+        std::printf("\n%10s %10s %9s %9s %10s %8s %6s %7s %9s %9s %9s %9s\n", "offered/s", "sent/s", "messages",
+                    "applied", "applied/s", "dropped", "gaps", "stalls", "p50(us)", "p99(us)", "p99.9(us)", "max(us)");
+        for (const auto& [rate, r] : results) {
+            std::string offered = rate > 0 ? std::to_string(static_cast<long long>(rate)) : "max";
+            std::printf("%10s %10.0f %9zu %9zu %10.0f %8zu %6zu %7zu %9.1f %9.1f %9.1f %9.1f\n", offered.c_str(),
+                        r.stream.frames_per_second(), r.book_messages, r.applied, r.applied_per_second, r.dropped,
+                        r.gaps, r.stream.stalls, percentile(r.latencies, 0.50) / 1e3,
+                        percentile(r.latencies, 0.99) / 1e3, percentile(r.latencies, 0.999) / 1e3,
+                        (r.latencies.empty() ? 0 : r.latencies.back()) / 1e3);
+        }
+        simulator.stop();
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,283 @@
+//
+// Created by Supradeep Chitumalla
+//
+// Replays one feed through the market data pipeline in each RoutingMode and
+// reports receive -> strategy-callback latency for every book message, so
+// inline and queued execution can be compared on identical input.
+//
+// usage: bench_pipeline [recording.rec] [--paced] [--workers N] [--queue N]
+//                       [--max-allocs X] [--metrics]
+//
+// Without a recording a synthetic feed is generated. --paced keeps the
+// recorded inter-arrival times; otherwise frames are replayed back to back,
+// which measures the pipeline under a sustained burst. --workers applies to
+// the sharded leg; shared mode always runs its single worker. As in main,
+// a burst that outruns a worker is conflated rather than dropped, so books
+// never lose sequence; frames merged into a later update have no latency
+// sample of their own.
+//
+// Heap allocations are counted over the second half of the replay, after
+// MarketData::prepare_memory() and with the first half as warm-up, once every
+// queue slot and book has been through a few messages. In steady state the
+// path from frame to callback should not allocate at all: the bench exits
+// non-zero if any mode exceeds --max-allocs per message (default 0.001).
+//
+// --metrics prints, after each mode, the market data part of what the
+// trading binary serves on /metrics.
+
+#include "alloc_counter.hpp"
+#include "book_decoder.hpp"
+#include "feed_recorder.hpp"
+#include "market_data.hpp"
+#include "metrics_text.hpp"
+#include "synthetic_feed.hpp"
+#include "tsc_clock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace deribit;
+
+namespace {
+
+    int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    constexpr size_t kReserveLevels = 64;      // as Config::Warmup::reserve_levels
+
+    uint64_t message_key(InstrumentId id, int64_t change_id) {
+        return (static_cast<uint64_t>(id) << 48) ^ static_cast<uint64_t>(change_id);
+    }
+
+    struct RunResult {
+        size_t book_messages = 0;
+        size_t delivered = 0;
+        double feed_ns_per_message = 0.0;      // time the replay thread spent per frame
+        double allocs_per_message = 0.0;       // heap allocations per book message, second half
+        size_t conflated = 0;                   // frames merged instead of queued
+        std::string metrics;                    // with --metrics
+        std::vector<int64_t> latencies;
+    };
+
+    RunResult run(RoutingMode mode, size_t workers, size_t queue_size, const std::vector<RecordedFrame>& frames,
+                  const std::vector<std::string>& names, bool paced, bool print_metrics) {
+        WaitConfig wait;
+        wait.kind = WaitKind::BusySpin;
+        MarketData md(workers, queue_size, mode, BackpressureMode::Conflate, wait);
+        md.prepare_memory(false, kReserveLevels);
+        for (const std::string& name : names) {
+            md.register_instrument(name);
+        }
+
+        // Decode once up front to map (instrument, change_id) -> frame index.
+        BookDecoder decoder(&md.instruments());
+        BookUpdate update;
+        // Each instrument's last frame is always applied, conflated or not.
+        std::unordered_map<uint64_t, size_t> index_of;
+        std::vector<size_t> last_frame(names.size(), frames.size());
+        for (size_t i = 0; i < frames.size(); ++i) {
+            if (decoder.decode(frames[i].payload, update) == DecodeStatus::Book &&
+                update.instrument_id != kInvalidInstrument) {
+                index_of[message_key(update.instrument_id, update.change_id)] = i;
+                if (update.instrument_id < last_frame.size()) {
+                    last_frame[update.instrument_id] = i;
+                }
+            }
+        }
+
+        // Each frame is applied exactly once, so each slot has a single writer.
+        // Both are TscClock ticks, as in the pipeline's own instrumentation.
+        std::vector<int64_t> received(frames.size(), 0);
+        std::vector<int64_t> latency(frames.size(), -1);
+        std::atomic<size_t> delivered{0};
+        std::vector<char> is_last(frames.size(), 0);
+        size_t lasts = 0;
+        for (size_t last : last_frame) {
+            if (last < frames.size()) {
+                is_last[last] = 1;
+                ++lasts;
+            }
+        }
+        std::atomic<size_t> lasts_delivered{0};     // releases the worker's latency writes
+        const InstrumentRegistry& registry = md.instruments();
+        md.set_update_callback([&](const std::string& symbol, const Orderbook& ob) {
+            int64_t now = TscClock::now();
+            auto it = index_of.find(message_key(registry.find(symbol), ob.change_id));
+            if (it != index_of.end() && latency[it->second] < 0) {
+                latency[it->second] = now - received[it->second];
+                delivered.fetch_add(1, std::memory_order_relaxed);
+                if (is_last[it->second]) {
+                    lasts_delivered.fetch_add(1, std::memory_order_release);
+                }
+            }
+        });
+
+        RunResult result;
+        int64_t replay_start = now_ns();
+        int64_t first_frame = frames.empty() ? 0 : frames.front().receive_ns;
+        size_t steady_from = frames.size() / 2;
+        size_t steady_messages = 0;
+        uint64_t steady_allocs = 0;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            if (i == steady_from) {
+                steady_allocs = heap_allocations().load();
+            }
+            if (paced) {
+                int64_t due = replay_start + (frames[i].receive_ns - first_frame);
+                while (now_ns() < due) {
+                    cpu_relax();
+                }
+            }
+            received[i] = TscClock::now();
+            if (decoder.decode(frames[i].payload, update) == DecodeStatus::Book) {
+                update.receive_ticks = received[i];
+                md.enqueue_orderbook_update(update);
+                ++result.book_messages;
+                if (i >= steady_from) ++steady_messages;
+            }
+        }
+        int64_t replay_ns = now_ns() - replay_start;
+
+        // Let the workers drain: done once every instrument's last frame is in.
+        int64_t deadline = now_ns() + 5000000000LL;
+        while (lasts_delivered.load(std::memory_order_acquire) < lasts && now_ns() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        steady_allocs = heap_allocations().load() - steady_allocs;
+        result.allocs_per_message = steady_messages == 0 ? 0.0
+            : static_cast<double>(steady_allocs) / static_cast<double>(steady_messages);
+
+        result.delivered = delivered.load();
+        result.conflated = md.get_conflated_message_count();
+        if (print_metrics) {
+            std::ostringstream text;
+            text.precision(9);
+            metrics_text::render_market_data(text, md);
+            result.metrics = text.str();
+        }
+        result.feed_ns_per_message = frames.empty() ? 0.0 : static_cast<double>(replay_ns) / frames.size();
+        for (int64_t l : latency) {
+            if (l >= 0) result.latencies.push_back(TscClock::to_ns(l));
+        }
+        std::sort(result.latencies.begin(), result.latencies.end());
+        return result;
+    }
+
+    int64_t percentile(const std::vector<int64_t>& sorted, double p) {
+        if (sorted.empty()) return 0;
+        return sorted[static_cast<size_t>(p * static_cast<double>(sorted.size() - 1))];
+    }
+
+    const char* mode_name(RoutingMode mode) {
+        switch (mode) {
+            case RoutingMode::Inline: return "inline";
+            case RoutingMode::Sharded: return "sharded";
+            case RoutingMode::Shared: return "shared";
+        }
+        return "?";
+    }
+
+    void print_usage(std::FILE* out, const char* argv0) {
+        std::fprintf(out, "usage: %s [recording.rec] [--paced] [--workers N] [--queue N] "
+                          "[--max-allocs X] [--metrics]\n",
+                     argv0);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string recording;
+    bool paced = false;
+    size_t workers = 1;
+    size_t queue_size = 16384;
+    double max_allocs = 0.001;
+    bool print_metrics = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--paced") == 0) {
+            paced = true;
+        } else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            queue_size = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--max-allocs") == 0 && i + 1 < argc) {
+            max_allocs = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--metrics") == 0) {
+            print_metrics = true;
+        } else if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+            print_usage(stdout, argv[0]);
+            return 0;
+        } else if (argv[i][0] == '-' || !recording.empty()) {
+            std::fprintf(stderr, "%s: unexpected argument '%s'\n", argv[0], argv[i]);
+            print_usage(stderr, argv[0]);
+            return 1;
+        } else {
+            recording = argv[i];
+        }
+    }
+    if (workers == 0 || queue_size == 0) {
+        print_usage(stderr, argv[0]);
+        return 1;
+    }
+
+    std::vector<RecordedFrame> frames;
+    if (recording.empty()) {
+        frames = SyntheticFeed().generate();
+        std::printf("synthetic feed: %zu frames\n", frames.size());
+    } else {
+        try {
+            frames = load_recording(recording);
+        } catch (const std::exception& e) {
+            std::fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+        std::printf("%s: %zu frames\n", recording.c_str(), frames.size());
+    }
+    std::vector<std::string> names = instruments_in(frames);
+    std::printf("%zu instruments, %s replay, %zu sharded worker(s) and %zu-slot queues for queued modes\n",
+                names.size(), paced ? "paced" : "back-to-back", workers, queue_size);
+    std::printf("timestamps: %s\n\n", TscClock::using_tsc() ? "invariant TSC" : "steady_clock");
+
+    std::printf("%-8s %9s %9s %10s %10s %10s %10s %12s %11s\n", "mode", "messages", "applied",
+                "p50(ns)", "p99(ns)", "p99.9(ns)", "max(ns)", "feed ns/msg", "allocs/msg");
+    std::vector<std::string> failures;
+    for (RoutingMode mode : {RoutingMode::Inline, RoutingMode::Sharded, RoutingMode::Shared}) {
+        // Shared mode keeps change_id order only with a single worker.
+        size_t mode_workers = (mode == RoutingMode::Shared) ? 1 : workers;
+        RunResult r = run(mode, mode_workers, queue_size, frames, names, paced, print_metrics);
+        std::printf("%-8s %9zu %9zu %10lld %10lld %10lld %10lld %12.0f %11.3f\n", mode_name(mode),
+                    r.book_messages, r.delivered,
+                    static_cast<long long>(percentile(r.latencies, 0.50)),
+                    static_cast<long long>(percentile(r.latencies, 0.99)),
+                    static_cast<long long>(percentile(r.latencies, 0.999)),
+                    static_cast<long long>(r.latencies.empty() ? 0 : r.latencies.back()),
+                    r.feed_ns_per_message, r.allocs_per_message);
+        if (r.conflated > 0) {
+            std::printf("%-8s %zu messages conflated\n", "", r.conflated);
+        }
+        if (r.allocs_per_message > max_allocs) {
+            failures.push_back(mode_name(mode));
+        }
+        if (!r.metrics.empty()) {
+            std::printf("\n%s\n", r.metrics.c_str());
+        }
+    }
+
+    if (!failures.empty()) {
+        std::printf("\nFAIL: steady-state allocations above %.3f per message in:", max_allocs);
+        for (const std::string& mode : failures) {
+            std::printf(" %s", mode.c_str());
+        }
+        std::printf("\n");
+        return 1;
+    }
+    return 0;
+}
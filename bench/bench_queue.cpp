@@ -0,0 +1,339 @@
+//
+// Created by Supradeep Chitumalla
+//
+// Throughput and queueing latency of Buffer for each way the system uses it:
+// 1P/1C (Spsc, a shard queue), 1P/NC (Spmc, the shared worker queue) and
+// NP/NC (Mpmc, the order queue). Every combination of payload, capacity,
+// thread pinning and position-counter padding is run twice:
+//
+//   burst  producers push back to back; msgs_per_sec is the queue's ceiling
+//          and latency is mostly time spent behind a full queue
+//   paced  each producer waits --gap-ns between pushes, so latency is the
+//          hand-off itself: push -> a consumer has the item
+//
+// Payloads are a 32-byte POD, a BookUpdate with 10 levels a side (what the
+// market data queues carry) and an OrderParams (the order queue). `padded`
+// 0 packs the two position counters onto one cache line, for checking what
+// the alignas(64) on them is worth.
+//
+// Results go to stdout as CSV (or JSON lines with --json), one row per run,
+// so runs of different builds can be diffed or loaded side by side.
+//
+// usage: bench_queue [--messages N] [--threads N] [--capacity N[,N...]]
+//                    [--pin on|off|both] [--gap-ns N] [--json]
+
+#include "book_update.hpp"
+#include "buffer.hpp"
+#include "latency_histogram.hpp"
+#include "order_params.hpp"
+#include "tsc_clock.hpp"
+#include "wait_strategy.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace deribit;
+
+namespace {
+
+    struct Pod {
+        int64_t stamp = 0;
+        uint64_t sequence = 0;
+        double price = 0.0;
+        double amount = 0.0;
+    };
+
+    // How the bench builds, stamps and reads each payload type.
+    template<typename T>
+    struct Payload;
+
+    template<>
+    struct Payload<Pod> {
+        static const char* name() { return "pod"; }
+        static Pod make() { return Pod{0, 0, 60000.5, 10.0}; }
+        static void stamp(Pod& p, int64_t ticks) { p.stamp = ticks; }
+        static int64_t stamp_of(const Pod& p) { return p.stamp; }
+    };
+
+    template<>
+    struct Payload<BookUpdate> {
+        static const char* name() { return "book_update"; }
+        static BookUpdate make() {
+            BookUpdate u;
+            u.instrument_id = 0;
+            u.change_id = 1;
+            for (int i = 0; i < 10; ++i) {
+                u.bids.push_back({LevelAction::Change, 60000.0 - 0.5 * i, 100.0});
+                u.asks.push_back({LevelAction::Change, 60000.5 + 0.5 * i, 100.0});
+            }
+            return u;
+        }
+        static void stamp(BookUpdate& u, int64_t ticks) { u.receive_ticks = ticks; }
+        static int64_t stamp_of(const BookUpdate& u) { return u.receive_ticks; }
+    };
+
+    template<>
+    struct Payload<OrderParams> {
+        static const char* name() { return "order_params"; }
+        static OrderParams make() {
+            OrderParams p("BTC-PERPETUAL", 10.0, 60000.5, "limit");
+            p.side = "buy";
+            p.callback = [](const std::string&, bool) {};
+            return p;
+        }
+        static void stamp(OrderParams& p, int64_t ticks) { p.trace.receive_ticks = ticks; }
+        static int64_t stamp_of(const OrderParams& p) { return p.trace.receive_ticks; }
+    };
+
+    struct Options {
+        size_t messages = 200000;
+        size_t threads = 0;                 // N for 1P/NC and NP/NC; 0 = from the core count
+        std::vector<size_t> capacities{1024, 65536};
+        std::vector<bool> pinning{false, true};
+        int64_t gap_ns = 2000;
+        bool json = false;
+    };
+
+    struct Run {
+        const char* scenario;
+        size_t producers;
+        size_t consumers;
+        const char* payload;
+        size_t payload_bytes;
+        size_t capacity;
+        bool pinned;
+        bool padded;
+        bool paced;
+    };
+
+    struct Result {
+        size_t messages = 0;
+        double seconds = 0.0;
+        HistogramSnapshot latency;      // ticks
+    };
+
+    void pin_to(size_t core) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(static_cast<int>(core % std::max(1u, std::thread::hardware_concurrency())), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    // Spinning on a full or empty queue, yielding now and then so that runs
+    // with more threads than cores still finish.
+    void backoff(uint32_t& polls) {
+        if (++polls % 64 == 0) {
+            std::this_thread::yield();
+        } else {
+            cpu_relax();
+        }
+    }
+
+    template<typename T, QueueMode Mode, size_t Align>
+    Result measure(const Run& run, size_t messages, int64_t gap_ticks) {
+        Buffer<T, Mode, Align> queue(run.capacity);
+        std::vector<LatencyHistogram> histograms(run.consumers);
+        std::vector<size_t> popped(run.consumers, 0);
+        std::atomic<size_t> ready{0};
+        std::atomic<bool> go{false};
+        std::atomic<size_t> producers_left{run.producers};
+        const size_t per_producer = messages / run.producers;
+
+        auto start_together = [&](size_t index) {
+            if (run.pinned) {
+                pin_to(index);
+            }
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                cpu_relax();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t c = 0; c < run.consumers; ++c) {
+            threads.emplace_back([&, c] {
+                start_together(run.producers + c);
+                T item = Payload<T>::make();
+                uint32_t polls = 0;
+                size_t count = 0;
+                while (true) {
+                    if (queue.try_pop(item)) {
+                        histograms[c].record(static_cast<uint64_t>(
+                            std::max<int64_t>(TscClock::now() - Payload<T>::stamp_of(item), 0)));
+                        ++count;
+                        polls = 0;
+                    } else if (producers_left.load(std::memory_order_acquire) == 0 && queue.empty()) {
+                        break;
+                    } else {
+                        backoff(polls);
+                    }
+                }
+                popped[c] = count;
+            });
+        }
+        for (size_t p = 0; p < run.producers; ++p) {
+            threads.emplace_back([&, p] {
+                start_together(p);
+                const T prototype = Payload<T>::make();
+                T item = prototype;
+                uint32_t polls = 0;
+                int64_t next = TscClock::now();
+                for (size_t i = 0; i < per_producer; ++i) {
+                    if (gap_ticks > 0) {
+                        while (TscClock::now() < next) {
+                            backoff(polls);
+                        }
+                        polls = 0;
+                        next += gap_ticks;
+                    }
+                    Payload<T>::stamp(item, TscClock::now());
+                    while (!queue.push(item)) {
+                        backoff(polls);
+                    }
+                    polls = 0;
+                }
+                producers_left.fetch_sub(1, std::memory_order_release);
+            });
+        }
+
+        while (ready.load() < run.producers + run.consumers) {
+            std::this_thread::yield();
+        }
+        int64_t start = TscClock::now();
+        go.store(true, std::memory_order_release);
+        for (auto& t : threads) {
+            t.join();
+        }
+        int64_t end = TscClock::now();
+
+        Result result;
+        result.seconds = static_cast<double>(TscClock::to_ns(end - start)) * 1e-9;
+        HistogramSnapshot part;
+        for (size_t c = 0; c < run.consumers; ++c) {
+            result.messages += popped[c];
+            histograms[c].snapshot_into(part);
+            result.latency.merge(part);
+        }
+        return result;
+    }
+
+    void report(const Options& options, const Run& run, const Result& r) {
+        auto ns = [](uint64_t ticks) { return static_cast<long long>(TscClock::to_ns(static_cast<int64_t>(ticks))); };
+        double rate = r.seconds > 0 ? static_cast<double>(r.messages) / r.seconds : 0.0;
+        if (options.json) {
+            std::printf("{\"scenario\":\"%s\",\"producers\":%zu,\"consumers\":%zu,\"payload\":\"%s\","
+                        "\"payload_bytes\":%zu,\"capacity\":%zu,\"pinned\":%d,\"padded\":%d,\"mode\":\"%s\","
+                        "\"messages\":%zu,\"seconds\":%.6f,\"msgs_per_sec\":%.0f,\"p50_ns\":%lld,"
+                        "\"p90_ns\":%lld,\"p99_ns\":%lld,\"p999_ns\":%lld,\"max_ns\":%lld}\n",
+                        run.scenario, run.producers, run.consumers, run.payload, run.payload_bytes,
+                        run.capacity, run.pinned, run.padded, run.paced ? "paced" : "burst", r.messages,
+                        r.seconds, rate, ns(r.latency.percentile(50.0)), ns(r.latency.percentile(90.0)),
+                        ns(r.latency.percentile(99.0)), ns(r.latency.percentile(99.9)), ns(r.latency.max()));
+        } else {
+            std::printf("%s,%zu,%zu,%s,%zu,%zu,%d,%d,%s,%zu,%.6f,%.0f,%lld,%lld,%lld,%lld,%lld\n",
+                        run.scenario, run.producers, run.consumers, run.payload, run.payload_bytes,
+                        run.capacity, run.pinned, run.padded, run.paced ? "paced" : "burst", r.messages,
+                        r.seconds, rate, ns(r.latency.percentile(50.0)), ns(r.latency.percentile(90.0)),
+                        ns(r.latency.percentile(99.0)), ns(r.latency.percentile(99.9)), ns(r.latency.max()));
+        }
+        std::fflush(stdout);
+    }
+
+    template<typename T, QueueMode Mode>
+    void run_scenario(const Options& options, const char* scenario, size_t producers, size_t consumers) {
+        const int64_t gap_ticks = static_cast<int64_t>(static_cast<double>(options.gap_ns) / TscClock::ns_per_tick());
+        for (size_t capacity : options.capacities) {
+            for (bool pinned : options.pinning) {
+                for (bool padded : {true, false}) {
+                    for (bool paced : {false, true}) {
+                        Run run{scenario, producers, consumers, Payload<T>::name(), sizeof(T),
+                                capacity, pinned, padded, paced};
+                        // Paced runs are rate-bound, so fewer messages say as much.
+                        size_t messages = paced ? std::max<size_t>(options.messages / 10, producers) : options.messages;
+                        int64_t gap = paced ? gap_ticks : 0;
+                        Result r = padded ? measure<T, Mode, 64>(run, messages, gap)
+                                          : measure<T, Mode, alignof(std::atomic<size_t>)>(run, messages, gap);
+                        report(options, run, r);
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename T>
+    void run_payload(const Options& options) {
+        run_scenario<T, QueueMode::Spsc>(options, "1p1c", 1, 1);
+        run_scenario<T, QueueMode::Spmc>(options, "1pnc", 1, options.threads);
+        run_scenario<T, QueueMode::Mpmc>(options, "npnc", options.threads, options.threads);
+    }
+
+    std::vector<size_t> parse_list(const std::string& text) {
+        std::vector<size_t> values;
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t comma = text.find(',', start);
+            if (comma == std::string::npos) {
+                comma = text.size();
+            }
+            if (size_t value = std::strtoul(text.substr(start, comma - start).c_str(), nullptr, 10)) {
+                values.push_back(value);
+            }
+            start = comma + 1;
+        }
+        return values;
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--messages") == 0 && i + 1 < argc) {
+            options.messages = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+            options.capacities = parse_list(argv[++i]);
+        } else if (std::strcmp(argv[i], "--pin") == 0 && i + 1 < argc) {
+            std::string pin = argv[++i];
+            options.pinning = pin == "on" ? std::vector<bool>{true}
+                            : pin == "off" ? std::vector<bool>{false}
+                            : std::vector<bool>{false, true};
+        } else if (std::strcmp(argv[i], "--gap-ns") == 0 && i + 1 < argc) {
+            options.gap_ns = std::strtoll(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--json") == 0) {
+            options.json = true;
+        } else {
+            std::fprintf(stderr, "usage: %s [--messages N] [--threads N] [--capacity N[,N...]] "
+                                 "[--pin on|off|both] [--gap-ns N] [--json]\n", argv[0]);
+            return 1;
+        }
+    }
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    if (options.threads == 0) {
+        options.threads = std::max<size_t>(2, std::min<size_t>(4, cores / 2));
+    }
+    if (options.messages == 0 || options.capacities.empty()) {
+        std::fprintf(stderr, "nothing to run\n");
+        return 1;
+    }
+
+    TscClock::calibrate();
+    std::fprintf(stderr, "%u cores, timestamps: %s, %zu messages per burst run, N = %zu\n", cores,
+                 TscClock::using_tsc() ? "invariant TSC" : "steady_clock", options.messages, options.threads);
+    if (!options.json) {
+        std::printf("scenario,producers,consumers,payload,payload_bytes,capacity,pinned,padded,mode,"
+                    "messages,seconds,msgs_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    }
+    run_payload<Pod>(options);
+    run_payload<BookUpdate>(options);
+    run_payload<OrderParams>(options);
+    return 0;
+}
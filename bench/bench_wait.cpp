@@ -0,0 +1,113 @@
+//
+// Created by Supradeep Chitumalla
+//
+// Wake-up latency vs. consumer CPU for each WaitKind.
+//
+// A producer pushes a timestamp into an SPSC Buffer at random intervals and
+// notifies; the consumer idles with the strategy under test between polls and
+// records how long each item sat in the queue. Consumer CPU time is taken
+// from the thread's own clock, so 100% means one core fully burned.
+//
+// usage: bench_wait [messages=2000] [mean_gap_us=200]
+
+#include "buffer.hpp"
+#include "wait_strategy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace deribit;
+
+namespace {
+
+    int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    int64_t thread_cpu_ns() {
+        timespec ts{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    struct Result {
+        std::vector<int64_t> latencies;
+        double cpu_percent = 0.0;
+    };
+
+    Result run(const WaitConfig& config, size_t messages, int mean_gap_us) {
+        Buffer<int64_t, QueueMode::Spsc> queue(1024);
+        WaitStrategy wait(config);
+        std::atomic<bool> done{false};
+        Result result;
+        result.latencies.reserve(messages);
+
+        std::thread consumer([&] {
+            int64_t cpu_start = thread_cpu_ns();
+            int64_t wall_start = now_ns();
+            uint32_t idle_polls = 0;
+            int64_t sent_at = 0;
+            while (result.latencies.size() < messages) {
+                if (queue.try_pop(sent_at)) {
+                    result.latencies.push_back(now_ns() - sent_at);
+                    idle_polls = 0;
+                } else {
+                    wait.idle(idle_polls, [&] { return !queue.empty() || done.load(); });
+                }
+            }
+            int64_t wall = now_ns() - wall_start;
+            result.cpu_percent = 100.0 * static_cast<double>(thread_cpu_ns() - cpu_start) / static_cast<double>(wall);
+        });
+
+        std::mt19937 rng(42);
+        std::exponential_distribution<double> gap(1.0 / mean_gap_us);
+        for (size_t i = 0; i < messages; ++i) {
+            std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(gap(rng))));
+            while (!queue.push(now_ns())) {
+                cpu_relax();
+            }
+            wait.notify();
+        }
+        done.store(true);
+        wait.wake_all();
+        consumer.join();
+        return result;
+    }
+
+    int64_t percentile(std::vector<int64_t>& sorted, double p) {
+        size_t idx = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+        return sorted[idx];
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t messages = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+    int mean_gap_us = argc > 2 ? std::atoi(argv[2]) : 200;
+    if (messages == 0) messages = 1;
+
+    std::printf("%zu messages, mean gap %d us, %u hardware threads\n\n",
+                messages, mean_gap_us, std::thread::hardware_concurrency());
+    std::printf("%-12s %10s %10s %10s %10s %8s\n", "strategy", "p50(ns)", "p99(ns)", "p99.9(ns)", "max(ns)", "cpu%");
+
+    for (WaitKind kind : {WaitKind::BusySpin, WaitKind::SpinYield, WaitKind::SpinPark, WaitKind::TimedSleep}) {
+        WaitConfig config;
+        config.kind = kind;
+        Result result = run(config, messages, mean_gap_us);
+        std::sort(result.latencies.begin(), result.latencies.end());
+        std::printf("%-12s %10lld %10lld %10lld %10lld %7.1f%%\n", to_string(kind),
+                    static_cast<long long>(percentile(result.latencies, 0.50)),
+                    static_cast<long long>(percentile(result.latencies, 0.99)),
+                    static_cast<long long>(percentile(result.latencies, 0.999)),
+                    static_cast<long long>(result.latencies.back()),
+                    result.cpu_percent);
+    }
+    return 0;
+}
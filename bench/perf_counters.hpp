@@ -0,0 +1,140 @@
+//
+// Created by Supradeep Chitumalla
+//
+// Hardware counters for the calling thread through perf_event_open(2):
+// cycles, instructions, cache references/misses and L1D read misses. Each
+// counter that the kernel, the CPU or the container refuses is reported as
+// unavailable rather than failing the benchmark (perf_event_paranoid, VMs
+// without a PMU, non-Linux builds).
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace deribit {
+
+    enum class PerfCounter : uint8_t {
+        Cycles,
+        Instructions,
+        CacheReferences,
+        CacheMisses,        // last-level cache
+        L1dReadMisses
+    };
+
+    constexpr size_t kPerfCounterCount = 5;
+
+    inline const char* to_string(PerfCounter counter) {
+        switch (counter) {
+            case PerfCounter::Cycles: return "cycles";
+            case PerfCounter::Instructions: return "instructions";
+            case PerfCounter::CacheReferences: return "cache-refs";
+            case PerfCounter::CacheMisses: return "cache-misses";
+            case PerfCounter::L1dReadMisses: return "L1d-misses";
+        }
+        return "unknown";
+    }
+
+    // Counts between start() and stop() on this thread only (user space).
+    class PerfCounters {
+    public:
+        PerfCounters() {
+#if defined(__linux__)
+            for (size_t i = 0; i < kPerfCounterCount; ++i) {
+                fds_[i] = open(static_cast<PerfCounter>(i));
+            }
+#endif
+        }
+
+        ~PerfCounters() {
+#if defined(__linux__)
+            for (int fd : fds_) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+#endif
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        bool available(PerfCounter counter) const { return fds_[static_cast<size_t>(counter)] >= 0; }
+
+        bool any_available() const {
+            for (int fd : fds_) {
+                if (fd >= 0) return true;
+            }
+            return false;
+        }
+
+        void start() {
+#if defined(__linux__)
+            for (int fd : fds_) {
+                if (fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+#endif
+        }
+
+        void stop() {
+#if defined(__linux__)
+            for (size_t i = 0; i < kPerfCounterCount; ++i) {
+                values_[i] = 0;
+                if (fds_[i] < 0) {
+                    continue;
+                }
+                ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+                uint64_t value = 0;
+                if (read(fds_[i], &value, sizeof(value)) == static_cast<ssize_t>(sizeof(value))) {
+                    values_[i] = value;
+                }
+            }
+#endif
+        }
+
+        // Of the last start()/stop(); 0 if unavailable.
+        uint64_t value(PerfCounter counter) const { return values_[static_cast<size_t>(counter)]; }
+
+    private:
+#if defined(__linux__)
+        static int open(PerfCounter counter) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            switch (counter) {
+                case PerfCounter::Cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+                case PerfCounter::Instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+                case PerfCounter::CacheReferences: attr.config = PERF_COUNT_HW_CACHE_REFERENCES; break;
+                case PerfCounter::CacheMisses: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+                case PerfCounter::L1dReadMisses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                    break;
+            }
+            return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+
+        std::array<int, kPerfCounterCount> fds_{-1, -1, -1, -1, -1};
+        std::array<uint64_t, kPerfCounterCount> values_{};
+    };
+}
+
+#endif //PERF_COUNTERS_H
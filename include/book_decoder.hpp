@@ -0,0 +1,42 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef BOOK_DECODER_H
+#define BOOK_DECODER_H
+
+#include "book_update.hpp"
+#include "instrument_registry.hpp"
+#include <string_view>
+
+namespace deribit {
+
+    enum class DecodeStatus {
+        Book,       // a book.* notification, decoded into the BookUpdate
+        NotBook,    // well-formed but something else (subscription ack, error, ...)
+        Malformed
+    };
+
+    // Single-pass decoder for Deribit `book.*` subscription notifications.
+    //
+    // Reads the payload in place: strings are returned as views into the frame,
+    // numbers are converted straight from the text, and anything the book path
+    // does not need is skipped without being materialised. Only the fields that
+    // make up a BookUpdate are looked at, so there is no DOM and no per-message
+    // allocation once the output's level vectors have grown to the feed's size.
+    //
+    // The instrument name is resolved against the registry without copying it;
+    // instruments that were never registered decode with kInvalidInstrument.
+    class BookDecoder {
+    public:
+        explicit BookDecoder(const InstrumentRegistry* instruments = nullptr)
+            : instruments_(instruments) {}
+
+        DecodeStatus decode(std::string_view payload, BookUpdate& out);
+
+    private:
+        const InstrumentRegistry* instruments_;
+    };
+}
+
+#endif //BOOK_DECODER_H
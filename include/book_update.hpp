@@ -0,0 +1,65 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef BOOK_UPDATE_H
+#define BOOK_UPDATE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "instrument_registry.hpp"
+
+namespace deribit {
+
+    enum class BookUpdateType : uint8_t {
+        Snapshot,
+        Change,
+        Conflated       // queue marker: apply the instrument's conflated updates now
+    };
+
+    enum class LevelAction : uint8_t {
+        New,
+        Change,
+        Delete
+    };
+
+    struct BookLevel {
+        LevelAction action = LevelAction::New;
+        double price = 0.0;
+        double amount = 0.0;
+    };
+
+    // Flat, typed form of a `book.*` notification. This is what travels through
+    // the MarketData queue instead of a Json::Value DOM.
+    struct BookUpdate {
+        InstrumentId instrument_id = kInvalidInstrument;
+        BookUpdateType type = BookUpdateType::Change;
+        int64_t timestamp = 0;
+        int64_t change_id = 0;
+        int64_t prev_change_id = 0;     // 0 when the feed did not send one (snapshots)
+        uint32_t conflation_generation = 0;     // Conflated markers only
+        uint64_t trace_id = 0;          // DeribitClient frame counter (TraceContext::id); 0 if not from the feed
+        int64_t receive_ticks = 0;      // TscClock::now() when the frame arrived; 0 if not from the feed
+        int64_t enqueue_ticks = 0;      // TscClock::now() when handed to MarketData
+        std::vector<BookLevel> bids;
+        std::vector<BookLevel> asks;
+
+        // Keeps vector capacity so a reused BookUpdate stops allocating once warm.
+        void clear() {
+            instrument_id = kInvalidInstrument;
+            type = BookUpdateType::Change;
+            timestamp = 0;
+            change_id = 0;
+            prev_change_id = 0;
+            conflation_generation = 0;
+            trace_id = 0;
+            receive_ticks = 0;
+            enqueue_ticks = 0;
+            bids.clear();
+            asks.clear();
+        }
+    };
+}
+
+#endif //BOOK_UPDATE_H
@@ -4,50 +4,255 @@
 
 #ifndef BUFFER_H
 #define BUFFER_H
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <utility>
 
 namespace deribit {
-    template<typename T>
+
+    // Which sides of a Buffer may be used from more than one thread. Only the
+    // shared side pays for a CAS; a single producer or consumer just stores.
+    enum class QueueMode {
+        Spsc,
+        Mpsc,
+        Spmc,
+        Mpmc
+    };
+
+    // Bounded lock-free queue (Vyukov). Every slot carries a sequence number
+    // that says whose turn it is: a producer may fill slot `pos` once its
+    // sequence equals pos, a consumer may empty it once it equals pos + 1.
+    // Producers and consumers therefore only contend on their own position
+    // counter, and an element is never touched before its slot is claimed.
+    // Capacity is rounded up to a power of two.
+    //
+    // The two position counters sit on separate cache lines so producers and
+    // consumers do not invalidate each other's line on every operation.
+    // PositionAlign exists so bench_queue can measure that against packed
+    // counters (alignof(std::atomic<size_t>)); leave it at the default.
+    template<typename T, QueueMode Mode = QueueMode::Mpmc, size_t PositionAlign = 64>
     class Buffer {
     private:
-        std::vector<T>buffer_;
+        static constexpr bool kMultiProducer = (Mode == QueueMode::Mpsc || Mode == QueueMode::Mpmc);
+        static constexpr bool kMultiConsumer = (Mode == QueueMode::Spmc || Mode == QueueMode::Mpmc);
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        std::unique_ptr<Cell[]> cells_;
         size_t capacity_;
-        alignas(64) std::atomic<size_t> head_;
-        alignas(64) std::atomic<size_t> tail_;
+        size_t mask_;
 
-    public:
-        explicit Buffer(size_t capacity) : capacity_(capacity),buffer_(capacity),head_(0), tail_(0) {
+        static_assert(PositionAlign >= alignof(std::atomic<size_t>) && (PositionAlign & (PositionAlign - 1)) == 0,
+                      "PositionAlign must be a power of two no smaller than the counter's alignment");
+
+        alignas(PositionAlign) std::atomic<size_t> enqueue_pos_;
+        alignas(PositionAlign) std::atomic<size_t> dequeue_pos_;
 
+        static size_t round_up_pow2(size_t n) {
+            size_t p = 2;
+            while (p < n) p <<= 1;
+            return p;
         }
-        bool push(const T& item) {
-            size_t head = head_.load(std::memory_order_relaxed);
-            size_t next_head = (head + 1) % capacity_;
-            if (next_head == tail_.load(std::memory_order_acquire)) {
+
+        // Claims the next slot for writing, or returns nullptr if the queue is full.
+        Cell* claim_for_push(size_t& pos) {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+            while (true) {
+                Cell* cell = &cells_[pos & mask_];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if constexpr (kMultiProducer) {
+                        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            return cell;
+                        }
+                    } else {
+                        enqueue_pos_.store(pos + 1, std::memory_order_relaxed);
+                        return cell;
+                    }
+                } else if (diff < 0) {
+                    return nullptr;
+                } else {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        template<typename U>
+        bool store(U&& value) {
+            size_t pos;
+            Cell* cell = claim_for_push(pos);
+            if (!cell) {
                 return false;
             }
-            buffer_[head] = item;
-            head_.store(next_head, std::memory_order_release);
+            cell->data = std::forward<U>(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
             return true;
         }
 
-        std::optional<T> pop() {
+        // Claims the oldest filled slot, or returns nullptr if the queue is empty.
+        Cell* claim_for_pop(size_t& pos) {
+            pos = dequeue_pos_.load(std::memory_order_relaxed);
             while (true) {
-                size_t tail = tail_.load(std::memory_order_acquire);
-                size_t head = head_.load(std::memory_order_acquire);
+                Cell* cell = &cells_[pos & mask_];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if constexpr (kMultiConsumer) {
+                        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            return cell;
+                        }
+                    } else {
+                        dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+                        return cell;
+                    }
+                } else if (diff < 0) {
+                    return nullptr;
+                } else {
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+        }
 
-                if (tail == head) {
-                    return std::nullopt;
+        // Claims the run of up to max_count consecutive slots starting at
+        // `counter` whose sequence is ready (pos + i + offset). A shared side
+        // claims the run with one CAS, retrying if another thread got there first.
+        size_t claim_bulk(std::atomic<size_t>& counter, size_t offset, size_t max_count,
+                          bool shared, size_t& pos) {
+            max_count = std::min(max_count, capacity_);
+            pos = counter.load(std::memory_order_relaxed);
+            while (true) {
+                size_t n = 0;
+                while (n < max_count &&
+                       cells_[(pos + n) & mask_].sequence.load(std::memory_order_acquire) == pos + n + offset) {
+                    ++n;
+                }
+                if (n == 0) {
+                    // Either full/empty, or another thread moved the counter on.
+                    size_t current = counter.load(std::memory_order_relaxed);
+                    if (current == pos) {
+                        return 0;
+                    }
+                    pos = current;
+                    continue;
+                }
+                if (!shared) {
+                    counter.store(pos + n, std::memory_order_relaxed);
+                    return n;
                 }
-                T value = buffer_[tail];
-                if (tail_.compare_exchange_weak(tail, (tail + 1) % capacity_,
-                                               std::memory_order_acq_rel,
-                                               std::memory_order_acquire)) {
-                    return value;
-                                               }
+                if (counter.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                    return n;
+                }
+            }
+        }
+
+    public:
+        explicit Buffer(size_t capacity)
+            : cells_(new Cell[round_up_pow2(capacity)]), capacity_(round_up_pow2(capacity)),
+              mask_(capacity_ - 1), enqueue_pos_(0), dequeue_pos_(0) {
+            for (size_t i = 0; i < capacity_; ++i) {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        // Assigning into the slot (rather than constructing a new T there) lets
+        // types like std::vector reuse the capacity the slot already has.
+        bool push(const T& item) { return store(item); }
+        bool push(T&& item) { return store(std::move(item)); }
+
+        template<typename... Args>
+        bool emplace(Args&&... args) {
+            return store(T(std::forward<Args>(args)...));
+        }
+
+        // Pushes as many of items[0..count) as fit, in order, claiming all their
+        // slots at once. Returns how many were pushed.
+        size_t push_bulk(const T* items, size_t count) {
+            size_t pos;
+            size_t n = claim_bulk(enqueue_pos_, 0, count, kMultiProducer, pos);
+            for (size_t i = 0; i < n; ++i) {
+                Cell& cell = cells_[(pos + i) & mask_];
+                cell.data = items[i];
+                cell.sequence.store(pos + i + 1, std::memory_order_release);
+            }
+            return n;
+        }
+
+        // Pops up to max_count of the oldest items into out[0..n), claiming them
+        // all at once; same swap semantics as try_pop(). Returns n.
+        size_t pop_bulk(T* out, size_t max_count) {
+            size_t pos;
+            size_t n = claim_bulk(dequeue_pos_, 1, max_count, kMultiConsumer, pos);
+            using std::swap;
+            for (size_t i = 0; i < n; ++i) {
+                Cell& cell = cells_[(pos + i) & mask_];
+                swap(out[i], cell.data);
+                cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+            }
+            return n;
+        }
+
+        // Swaps rather than moves out of the slot, so whatever `out` held goes
+        // back into the ring. For a reused T that keeps its buffers circulating
+        // between producer and consumer; pass a default T to leave nothing behind.
+        bool try_pop(T& out) {
+            size_t pos;
+            Cell* cell = claim_for_pop(pos);
+            if (!cell) {
+                return false;
             }
+            using std::swap;
+            swap(out, cell->data);
+            cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+        std::optional<T> pop() {
+            size_t pos;
+            Cell* cell = claim_for_pop(pos);
+            if (!cell) {
+                return std::nullopt;
+            }
+            std::optional<T> value(std::move(cell->data));
+            cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+            return value;
+        }
+
+        // True once everything pushed so far has been claimed by a consumer.
+        bool empty() const {
+            return dequeue_pos_.load(std::memory_order_acquire) == enqueue_pos_.load(std::memory_order_acquire);
         }
 
+        // Approximate while producers or consumers are active.
+        size_t size() const {
+            size_t head = enqueue_pos_.load(std::memory_order_acquire);
+            size_t tail = dequeue_pos_.load(std::memory_order_acquire);
+            return head > tail ? head - tail : 0;
+        }
+
+        size_t capacity() const { return capacity_; }
+
+        // The ring's memory, for pre-faulting or locking it.
+        void* storage() { return cells_.get(); }
+        size_t storage_bytes() const { return capacity_ * sizeof(Cell); }
+
+        // Calls fn(T&) on the element in every slot, e.g. to reserve buffers up
+        // front. Only while nothing is pushing or popping.
+        template<typename Fn>
+        void for_each_element(Fn&& fn) {
+            for (size_t i = 0; i < capacity_; ++i) {
+                fn(cells_[i].data);
+            }
+        }
     };
 }
 
@@ -3,20 +3,24 @@
 //
 #ifndef CONFIG_H
 #define CONFIG_H
+#include <cstddef>
 #include <string>
 #include <vector>
 namespace deribit {
 
     struct Config {
         static constexpr const char* BASE_URL = "https://test.deribit.com/api/v2";
-        static constexpr const char* WS_URL = "wss://test.deribit.com/ws/api/v2";
+
+        // Market data WebSocket; ws:// or wss://. Point it at a local
+        // feed_simulator (e.g. ws://127.0.0.1:9000) to test without testnet.
+        std::string ws_url = "wss://test.deribit.com/ws/api/v2";
 
         std::string client_id;
         std::string client_secret;
         std::string access_token;
 
         struct Server {
-            int websocket_port;
+            int websocket_port;     // local metrics endpoint (MetricsServer); 0 = off
         } server;
 
         struct Trading {
@@ -24,6 +28,36 @@ namespace deribit {
             std::string default_instrument;
         } trading;
 
+        // Core lists per thread role; empty = let the scheduler place it.
+        // A role with fewer cores than threads wraps around the list.
+        struct Threading {
+            std::vector<int> io_cores;
+            std::vector<int> shard_cores;
+            std::vector<int> order_cores;
+            int realtime_priority = 0;      // SCHED_FIFO priority, 0 = off
+            bool numa_local_memory = true;  // allocate shard queues/books on the worker's node
+        } threading;
+
+        // Optional warm-up before the system reports ready (see Warmup).
+        struct Warmup {
+            bool enabled = false;
+            size_t max_updates = 50000;     // synthetic book updates at most
+            size_t window = 500;            // updates per latency sample
+            double tolerance = 0.10;        // steady once three windows' p50 agree within this
+            bool lock_memory = false;       // mlockall(MCL_CURRENT | MCL_FUTURE)
+            bool huge_pages = true;         // THP for the queue rings
+            size_t reserve_levels = 64;     // levels per side reserved in every queue slot
+        } warmup;
+
+        // Per-thread event rings (EventTracer), dumped from the menu or when a
+        // message or strategy order takes longer than trigger_us end to end.
+        struct Trace {
+            bool enabled = false;
+            size_t ring_events = 65536;     // per thread, rounded up to a power of two
+            int64_t trigger_us = 0;         // 0 = dump on demand only
+            std::string path = "trace.bin"; // where the trigger dumps
+        } trace;
+
         // Default constructor
         Config() : server{8080}, trading{"BTC", "BTC-PERPETUAL"} {}
 
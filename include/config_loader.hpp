@@ -51,8 +51,61 @@ namespace deribit {
                 "BTC-PERPETUAL"    // default_instrument
             );
 
+            // Optional market data endpoint override (a local feed_simulator)
+            config.ws_url = root.get("ws_url", config.ws_url).asString();
+
+            // Optional local server port (metrics endpoint); 0 disables it
+            const Json::Value& server = root["server"];
+            if (server.isObject()) {
+                config.server.websocket_port = server.get("websocket_port", config.server.websocket_port).asInt();
+            }
+
+            // Optional thread placement
+            const Json::Value& threading = root["threading"];
+            if (threading.isObject()) {
+                read_cores(threading["io_cores"], config.threading.io_cores);
+                read_cores(threading["shard_cores"], config.threading.shard_cores);
+                read_cores(threading["order_cores"], config.threading.order_cores);
+                config.threading.realtime_priority = threading.get("realtime_priority", 0).asInt();
+                config.threading.numa_local_memory = threading.get("numa_local_memory", true).asBool();
+            }
+
+            // Optional startup warm-up
+            const Json::Value& warmup = root["warmup"];
+            if (warmup.isObject()) {
+                Config::Warmup& w = config.warmup;
+                w.enabled = warmup.get("enabled", true).asBool();
+                w.max_updates = warmup.get("max_updates", Json::UInt64(w.max_updates)).asUInt64();
+                w.window = warmup.get("window", Json::UInt64(w.window)).asUInt64();
+                w.tolerance = warmup.get("tolerance", w.tolerance).asDouble();
+                w.lock_memory = warmup.get("lock_memory", w.lock_memory).asBool();
+                w.huge_pages = warmup.get("huge_pages", w.huge_pages).asBool();
+                w.reserve_levels = warmup.get("reserve_levels", Json::UInt64(w.reserve_levels)).asUInt64();
+            }
+
+            // Optional event tracing
+            const Json::Value& trace = root["trace"];
+            if (trace.isObject()) {
+                Config::Trace& t = config.trace;
+                t.enabled = trace.get("enabled", true).asBool();
+                t.ring_events = trace.get("ring_events", Json::UInt64(t.ring_events)).asUInt64();
+                t.trigger_us = trace.get("trigger_us", Json::Int64(t.trigger_us)).asInt64();
+                t.path = trace.get("path", t.path).asString();
+            }
+
             return config;
         }
+
+    private:
+        static void read_cores(const Json::Value& value, std::vector<int>& out) {
+            out.clear();
+            if (!value.isArray()) {
+                return;
+            }
+            for (const auto& core : value) {
+                out.push_back(core.asInt());
+            }
+        }
     };
 
 } // namespace deribit
@@ -7,8 +7,10 @@
 
 #include "config.hpp"
 #include "market_data.hpp"
+#include "book_decoder.hpp"
+#include "feed_recorder.hpp"
+#include "ws_message_pool.hpp"
 #include <websocketpp/client.hpp>
-#include <websocketpp/config/asio_client.hpp>
 #include <json/json.h>
 #include <thread>
 #include <mutex>
@@ -17,7 +19,8 @@
 namespace deribit {
     class DeribitClient {
     public:
-        using client = websocketpp::client<websocketpp::config::asio_tls_client>;
+        using client = websocketpp::client<DeribitTlsConfig>;     // TLS client (pooled frame buffers if enabled)
+        using plain_client = websocketpp::client<DeribitPlainConfig>;   // ws://, e.g. a local feed_simulator
         using connection_hdl = websocketpp::connection_hdl;
         using message_ptr = client::message_ptr;
 
@@ -29,19 +32,47 @@ namespace deribit {
         void subscribe(const std::string& symbol);
         bool is_connected() const;
 
+        // Record every received frame to `path` until stop_recording().
+        void start_recording(const std::string& path);
+        size_t stop_recording();    // returns the number of frames written
+        bool is_recording() const { return recording_.load(std::memory_order_relaxed); }
+
     private:
         void on_message(connection_hdl hdl, message_ptr msg);
 
+        template<typename Endpoint>
+        void init_endpoint(Endpoint& endpoint);
+
+        // The endpoint connect() chose from the URL scheme.
+        template<typename Fn>
+        void with_endpoint(Fn&& fn) {
+            if (secure_) {
+                fn(ws_client_);
+            } else {
+                fn(plain_client_);
+            }
+        }
+
         Config& config_;
         MarketData* market_manager_;
         client ws_client_;
-        client::connection_ptr connection_;
+        plain_client plain_client_;
+        bool secure_ = true;                // wss://; set by connect() before the IO thread starts
         connection_hdl connection_hdl_;
         std::thread client_thread_;
 
         mutable std::mutex connection_mutex_;
         std::atomic<bool> is_connected_;
         std::atomic<int> subscription_id_{1};
+
+        // Only touched from the WebSocket thread; reused across messages.
+        BookDecoder book_decoder_;
+        BookUpdate book_update_;
+        uint64_t next_trace_id_ = 0;        // TraceContext::id of the last book frame
+
+        std::atomic<bool> recording_{false};
+        std::mutex recorder_mutex_;
+        FeedRecorder recorder_;
     };
 }
 #endif //DERIBIT_CLIENT_H
\ No newline at end of file
@@ -0,0 +1,191 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace deribit {
+
+    // Epoch-based reclamation for read-mostly published objects.
+    //
+    // A reader pins the domain for the duration of a read by announcing the
+    // current global epoch in its own slot. A writer that unpublishes an object
+    // tags it with the epoch it retired in and may reuse it once every pinned
+    // reader has announced a later epoch. Readers never block and never allocate;
+    // each reader thread claims one slot the first time it pins.
+    class EpochDomain {
+    public:
+        static constexpr size_t kMaxReaders = 128;
+        static constexpr uint64_t kIdle = std::numeric_limits<uint64_t>::max();
+
+        static EpochDomain& global() {
+            static EpochDomain domain;
+            return domain;
+        }
+
+        class Guard {
+        public:
+            explicit Guard(std::atomic<uint64_t>& slot) : slot_(&slot) {}
+            Guard(Guard&& other) noexcept : slot_(std::exchange(other.slot_, nullptr)) {}
+            Guard(const Guard&) = delete;
+            Guard& operator=(const Guard&) = delete;
+            Guard& operator=(Guard&&) = delete;
+            ~Guard() {
+                if (slot_) slot_->store(kIdle, std::memory_order_release);
+            }
+        private:
+            std::atomic<uint64_t>* slot_;
+        };
+
+        // Pins are not reentrant: do not pin again while a Guard is alive on this thread.
+        Guard pin() {
+            std::atomic<uint64_t>& slot = slots_[reader_slot()].epoch;
+            slot.store(global_epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            return Guard(slot);
+        }
+
+        // Called by a writer after unpublishing an object; returns the epoch to tag it with.
+        uint64_t retire_epoch() {
+            return global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+        }
+
+        // Objects retired in an epoch strictly below this are unreachable by readers.
+        uint64_t safe_epoch() const {
+            uint64_t min_epoch = global_epoch_.load(std::memory_order_seq_cst);
+            size_t used = slots_used_.load(std::memory_order_seq_cst);
+            for (size_t i = 0; i < used; ++i) {
+                uint64_t e = slots_[i].epoch.load(std::memory_order_seq_cst);
+                if (e < min_epoch) min_epoch = e;
+            }
+            return min_epoch;
+        }
+
+    private:
+        struct alignas(64) ReaderSlot {
+            std::atomic<uint64_t> epoch{kIdle};
+            std::atomic<bool> claimed{false};
+        };
+
+        // Claims a slot for this thread and gives it back when the thread exits.
+        struct Registration {
+            EpochDomain* domain;
+            size_t index;
+
+            explicit Registration(EpochDomain* d) : domain(d), index(d->claim_slot()) {}
+            ~Registration() {
+                domain->slots_[index].claimed.store(false, std::memory_order_release);
+            }
+        };
+
+        EpochDomain() = default;
+
+        size_t reader_slot() {
+            thread_local Registration registration(this);
+            return registration.index;
+        }
+
+        size_t claim_slot() {
+            for (size_t i = 0; i < kMaxReaders; ++i) {
+                bool expected = false;
+                if (slots_[i].claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    // Writers only scan slots below the high-water mark.
+                    size_t used = slots_used_.load(std::memory_order_relaxed);
+                    while (used < i + 1 &&
+                           !slots_used_.compare_exchange_weak(used, i + 1, std::memory_order_seq_cst)) {
+                    }
+                    return i;
+                }
+            }
+            throw std::runtime_error("EpochDomain: too many concurrent reader threads");
+        }
+
+        alignas(64) std::atomic<uint64_t> global_epoch_{1};
+        std::atomic<size_t> slots_used_{0};
+        ReaderSlot slots_[kMaxReaders];
+    };
+
+    // Single-writer publication of immutable snapshots.
+    //
+    // The writer fills a buffer from acquire() and hands it to publish(); readers
+    // see either the previous or the new snapshot in full. Retired snapshots are
+    // recycled once no reader can still hold them, so steady-state publishing
+    // does not allocate either.
+    template<typename T>
+    class SnapshotPublisher {
+    public:
+        explicit SnapshotPublisher(EpochDomain& domain = EpochDomain::global())
+            : domain_(domain), current_(nullptr) {}
+
+        SnapshotPublisher(const SnapshotPublisher&) = delete;
+        SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+        // Writer: a buffer to fill for the next publish().
+        T* acquire() {
+            if (free_.empty()) {
+                reclaim();
+            }
+            if (!free_.empty()) {
+                T* snapshot = free_.back();
+                free_.pop_back();
+                return snapshot;
+            }
+            storage_.push_back(std::make_unique<T>());
+            return storage_.back().get();
+        }
+
+        // Writer: make `snapshot` (from acquire()) the current one.
+        void publish(T* snapshot) {
+            T* old = current_.exchange(snapshot, std::memory_order_seq_cst);
+            if (old) {
+                retired_.emplace_back(old, domain_.retire_epoch());
+            }
+        }
+
+        // Reader: runs fn(const T&) against the current snapshot. False if none yet.
+        template<typename Fn>
+        bool read(Fn&& fn) const {
+            auto guard = domain_.pin();
+            const T* snapshot = current_.load(std::memory_order_seq_cst);
+            if (!snapshot) {
+                return false;
+            }
+            fn(*snapshot);
+            return true;
+        }
+
+    private:
+        void reclaim() {
+            if (retired_.empty()) return;
+
+            uint64_t safe = domain_.safe_epoch();
+            size_t kept = 0;
+            for (auto& entry : retired_) {
+                if (entry.second < safe) {
+                    free_.push_back(entry.first);
+                } else {
+                    retired_[kept++] = entry;
+                }
+            }
+            retired_.resize(kept);
+        }
+
+        EpochDomain& domain_;
+        std::atomic<T*> current_;
+
+        // Writer-only bookkeeping.
+        std::vector<std::pair<T*, uint64_t>> retired_;
+        std::vector<T*> free_;
+        std::vector<std::unique_ptr<T>> storage_;
+    };
+}
+
+#endif //EPOCH_H
@@ -0,0 +1,363 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tsc_clock.hpp"
+
+namespace deribit {
+
+    enum class TraceEvent : uint8_t {
+        Received,       // book frame arrived (DeribitClient, arg: instrument id)
+        Enqueued,       // handed to MarketData
+        Dequeued,       // a worker starts applying it
+        Applied,        // book updated, published, callback returned
+        OrderSent,      // order worker sends the REST request
+        OrderAcked      // response received (arg: 1 = accepted, 0 = failed)
+    };
+
+    constexpr size_t kTraceEventCount = 6;
+
+    inline const char* to_string(TraceEvent event) {
+        switch (event) {
+            case TraceEvent::Received: return "received";
+            case TraceEvent::Enqueued: return "enqueued";
+            case TraceEvent::Dequeued: return "dequeued";
+            case TraceEvent::Applied: return "applied";
+            case TraceEvent::OrderSent: return "order_sent";
+            case TraceEvent::OrderAcked: return "order_acked";
+        }
+        return "unknown";
+    }
+
+    struct TraceRecord {
+        int64_t ticks = 0;              // TscClock
+        uint64_t trace_id = 0;          // TraceContext::id; 0 = not tied to a feed message
+        uint32_t arg = 0;
+        TraceEvent event = TraceEvent::Received;
+    };
+
+    // The last `capacity` events of one thread. Only that thread pushes: three
+    // relaxed stores and a release store of the head, no lock, no allocation,
+    // nothing shared with another writer. copy() may run at the same time; it
+    // drops whatever the writer could have overwritten while it was reading.
+    class TraceRing {
+    public:
+        TraceRing(std::string name, size_t capacity)
+            : name_(std::move(name)), capacity_(capacity), slots_(new Slot[capacity]) {
+            if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+                throw std::invalid_argument("TraceRing capacity must be a power of two");
+            }
+        }
+
+        const std::string& name() const { return name_; }
+        size_t capacity() const { return capacity_; }
+
+        // Owner thread only.
+        void push(TraceEvent event, uint64_t trace_id, uint32_t arg, int64_t ticks) {
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            // Orders the slot stores after the head store that published the
+            // previous event, so a reader that sees them also sees the head
+            // move (and knows the slot may be torn).
+            std::atomic_thread_fence(std::memory_order_release);
+            Slot& slot = slots_[head & (capacity_ - 1)];
+            slot.ticks.store(ticks, std::memory_order_relaxed);
+            slot.trace_id.store(trace_id, std::memory_order_relaxed);
+            slot.info.store(static_cast<uint64_t>(event) << 32 | arg, std::memory_order_relaxed);
+            head_.store(head + 1, std::memory_order_release);
+        }
+
+        // Oldest first.
+        std::vector<TraceRecord> copy() const {
+            uint64_t head = head_.load(std::memory_order_acquire);
+            uint64_t begin = head > capacity_ ? head - capacity_ : 0;
+            std::vector<TraceRecord> out;
+            out.reserve(static_cast<size_t>(head - begin));
+            for (uint64_t i = begin; i < head; ++i) {
+                const Slot& slot = slots_[i & (capacity_ - 1)];
+                uint64_t info = slot.info.load(std::memory_order_relaxed);
+                TraceRecord record;
+                record.ticks = slot.ticks.load(std::memory_order_relaxed);
+                record.trace_id = slot.trace_id.load(std::memory_order_relaxed);
+                record.arg = static_cast<uint32_t>(info);
+                record.event = static_cast<TraceEvent>(info >> 32);
+                out.push_back(record);
+            }
+
+            // The writer may be on index `now` without having published it,
+            // so anything below now + 1 - capacity may have been reused.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t now = head_.load(std::memory_order_relaxed);
+            uint64_t first_valid = now + 1 > capacity_ ? now + 1 - capacity_ : 0;
+            if (first_valid > begin) {
+                out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(
+                    std::min<uint64_t>(first_valid - begin, out.size())));
+            }
+            return out;
+        }
+
+    private:
+        struct Slot {
+            std::atomic<int64_t> ticks{0};
+            std::atomic<uint64_t> trace_id{0};
+            std::atomic<uint64_t> info{0};      // event << 32 | arg
+        };
+
+        std::string name_;
+        size_t capacity_;
+        std::unique_ptr<Slot[]> slots_;
+        alignas(64) std::atomic<uint64_t> head_{0};
+    };
+
+    // A dump, as read back by load_trace().
+    struct TraceDump {
+        struct Thread {
+            std::string name;
+            std::vector<TraceRecord> records;
+        };
+        double ns_per_tick = 1.0;
+        std::vector<Thread> threads;
+    };
+
+    // Per-thread event rings for looking inside a latency spike after the fact.
+    // A thread gets a ring, named after it (ThreadTopology names threads), the
+    // first time it records. With tracing off, record() is one relaxed load
+    // and no ring is ever allocated.
+    //
+    // Rings are written out with dump(), either on demand or from the
+    // trigger: the first book message (or traced order) slower end to end than
+    // the armed threshold dumps every ring from a background thread. Convert a
+    // dump with tools/trace_to_chrome for chrome://tracing or Perfetto.
+    //
+    // Dump format, native byte order: "DRBTRC01", double ns_per_tick,
+    // uint32 thread count, then per thread: uint32 name length, name,
+    // uint64 record count, records of {int64 ticks, uint64 trace_id,
+    // uint32 arg, uint32 event}.
+    class EventTracer {
+    public:
+        static constexpr char kMagic[8] = {'D', 'R', 'B', 'T', 'R', 'C', '0', '1'};
+
+        static EventTracer& global() {
+            static EventTracer tracer;
+            return tracer;
+        }
+
+        ~EventTracer() {
+            join_trigger();
+        }
+
+        // Startup, before the traced threads record. `ring_events` is per
+        // thread and rounded up to a power of two.
+        void configure(bool enabled, size_t ring_events) {
+            size_t capacity = 1;
+            while (capacity < ring_events) {
+                capacity <<= 1;
+            }
+            ring_events_ = capacity;
+            enabled_.store(enabled, std::memory_order_relaxed);
+        }
+
+        static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+        static void record(TraceEvent event, uint64_t trace_id, uint32_t arg, int64_t ticks) {
+            if (!enabled_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            ring().push(event, trace_id, arg, ticks);
+        }
+
+        // Reads the clock only when tracing is on.
+        static void record(TraceEvent event, uint64_t trace_id, uint32_t arg = 0) {
+            if (!enabled_.load(std::memory_order_relaxed)) {
+                return;
+            }
+            ring().push(event, trace_id, arg, TscClock::now());
+        }
+
+        // One-shot: the first latency above `threshold_ns` passed to check()
+        // dumps to `path`. Call again to re-arm.
+        void arm_trigger(int64_t threshold_ns, const std::string& path) {
+            join_trigger();
+            trigger_path_ = path;
+            auto ticks = static_cast<int64_t>(static_cast<double>(threshold_ns) / TscClock::ns_per_tick());
+            trigger_ticks_.store(std::max<int64_t>(ticks, 1), std::memory_order_release);
+        }
+
+        // Hot path: one relaxed load and a compare unless it fires.
+        static void check(int64_t latency_ticks) {
+            if (latency_ticks > trigger_ticks_.load(std::memory_order_relaxed)) {
+                global().fire(latency_ticks);
+            }
+        }
+
+        // Any thread, while the rings are being written. Returns events written.
+        size_t dump(const std::string& path) const {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                throw std::runtime_error("Failed to open trace file: " + path);
+            }
+            std::vector<std::pair<std::string, std::vector<TraceRecord>>> threads;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& ring : rings_) {
+                    threads.emplace_back(ring->name(), ring->copy());
+                }
+            }
+
+            size_t events = 0;
+            out.write(kMagic, sizeof(kMagic));
+            put(out, TscClock::ns_per_tick());
+            put(out, static_cast<uint32_t>(threads.size()));
+            for (const auto& [name, records] : threads) {
+                put(out, static_cast<uint32_t>(name.size()));
+                out.write(name.data(), static_cast<std::streamsize>(name.size()));
+                put(out, static_cast<uint64_t>(records.size()));
+                for (const TraceRecord& r : records) {
+                    put(out, r.ticks);
+                    put(out, r.trace_id);
+                    put(out, r.arg);
+                    put(out, static_cast<uint32_t>(r.event));
+                }
+                events += records.size();
+            }
+            if (!out) {
+                throw std::runtime_error("Failed to write trace file: " + path);
+            }
+            return events;
+        }
+
+    private:
+        static constexpr int64_t kDisarmed = std::numeric_limits<int64_t>::max();
+
+        EventTracer() = default;
+
+        static TraceRing& ring() {
+            if (!ring_) {
+                ring_ = global().add_ring();
+            }
+            return *ring_;
+        }
+
+        TraceRing* add_ring() {
+            char name[16] = {};
+            if (pthread_getname_np(pthread_self(), name, sizeof(name)) != 0 || name[0] == '\0') {
+                std::strcpy(name, "thread");
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            rings_.push_back(std::make_unique<TraceRing>(name, ring_events_));
+            return rings_.back().get();
+        }
+
+        void fire(int64_t latency_ticks) {
+            int64_t armed = trigger_ticks_.load(std::memory_order_acquire);
+            if (armed == kDisarmed ||
+                !trigger_ticks_.compare_exchange_strong(armed, kDisarmed, std::memory_order_acq_rel)) {
+                return;
+            }
+            // Off the thread that saw the spike; it keeps tracing meanwhile.
+            std::lock_guard<std::mutex> lock(trigger_mutex_);
+            trigger_thread_ = std::thread([this, latency_ticks] {
+                try {
+                    size_t events = dump(trigger_path_);
+                    std::cout << "Trace trigger: " << TscClock::to_ns(latency_ticks) / 1000 << " us message, "
+                              << events << " events written to " << trigger_path_ << std::endl;
+                } catch (const std::exception& e) {
+                    std::cout << "Trace trigger: " << e.what() << std::endl;
+                }
+            });
+        }
+
+        void join_trigger() {
+            std::thread done;
+            {
+                std::lock_guard<std::mutex> lock(trigger_mutex_);
+                done = std::move(trigger_thread_);
+            }
+            if (done.joinable()) {
+                done.join();
+            }
+        }
+
+        template<typename T>
+        static void put(std::ostream& out, T value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        static inline std::atomic<bool> enabled_{false};
+        static inline std::atomic<int64_t> trigger_ticks_{kDisarmed};
+        static inline thread_local TraceRing* ring_ = nullptr;
+
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<TraceRing>> rings_;
+        size_t ring_events_ = 65536;
+        std::string trigger_path_;
+        std::mutex trigger_mutex_;
+        std::thread trigger_thread_;
+    };
+
+    inline TraceDump load_trace(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open trace file: " + path);
+        }
+        auto get = [&in, &path](auto& value) {
+            in.read(reinterpret_cast<char*>(&value), sizeof(value));
+            if (!in) {
+                throw std::runtime_error("Truncated trace file: " + path);
+            }
+        };
+
+        char magic[sizeof(EventTracer::kMagic)];
+        in.read(magic, sizeof(magic));
+        if (!in || std::memcmp(magic, EventTracer::kMagic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Not an event trace: " + path);
+        }
+        TraceDump dump;
+        uint32_t threads = 0;
+        get(dump.ns_per_tick);
+        get(threads);
+        for (uint32_t t = 0; t < threads; ++t) {
+            TraceDump::Thread thread;
+            uint32_t name_size = 0;
+            uint64_t count = 0;
+            get(name_size);
+            thread.name.resize(name_size);
+            in.read(thread.name.data(), name_size);
+            get(count);
+            thread.records.resize(static_cast<size_t>(count));
+            for (TraceRecord& r : thread.records) {
+                uint32_t event = 0;
+                get(r.ticks);
+                get(r.trace_id);
+                get(r.arg);
+                get(event);
+                if (event >= kTraceEventCount) {
+                    throw std::runtime_error("Corrupt trace file: " + path);
+                }
+                r.event = static_cast<TraceEvent>(event);
+            }
+            dump.threads.push_back(std::move(thread));
+        }
+        return dump;
+    }
+}
+
+#endif //EVENT_TRACE_H
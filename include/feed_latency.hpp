@@ -0,0 +1,76 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef FEED_LATENCY_H
+#define FEED_LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "latency_histogram.hpp"
+
+namespace deribit {
+
+    // Wall clock, for comparing against exchange timestamps. Pipeline stages
+    // use TscClock instead; this is only meaningful relative to other hosts.
+    inline int64_t wall_clock_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // How late one instrument's feed arrives, before any of our processing.
+    //
+    // delay: local receive time minus the exchange `timestamp` of the message.
+    // It includes the exchange's own publishing delay, the network and any
+    // offset between the two clocks, so it is for comparing with itself over
+    // time (and with the processing stages), not an absolute one-way latency.
+    //
+    // jitter: how much the delay changed between consecutive messages, i.e.
+    // |(R2 - R1) - (S2 - S1)| for receive times R and exchange times S (the
+    // RFC 3550 definition). It works for the 100ms channel even when an
+    // interval is skipped because nothing changed, and a clock offset cancels
+    // out. Exchange timestamps are in milliseconds, so both are within ~1 ms.
+    //
+    // Written only by the feed thread; histograms may be read from anywhere.
+    class FeedTiming {
+    public:
+        static constexpr int64_t kNsPerMs = 1000000;
+
+        void record(int64_t exchange_ms, int64_t receive_wall_ns) {
+            int64_t exchange_ns = exchange_ms * kNsPerMs;
+            int64_t delay = receive_wall_ns - exchange_ns;
+            if (delay < 0) {
+                // The exchange stamped it after we say it arrived: clocks disagree.
+                ahead_.store(ahead_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+            delay_.record(static_cast<uint64_t>(delay < 0 ? 0 : delay));
+
+            if (last_exchange_ns_ != 0 && exchange_ns >= last_exchange_ns_) {
+                int64_t d = (receive_wall_ns - last_receive_ns_) - (exchange_ns - last_exchange_ns_);
+                jitter_.record(static_cast<uint64_t>(d < 0 ? -d : d));
+            }
+            last_exchange_ns_ = exchange_ns;
+            last_receive_ns_ = receive_wall_ns;
+        }
+
+        // Both in nanoseconds.
+        const LatencyHistogram& delay() const { return delay_; }
+        const LatencyHistogram& jitter() const { return jitter_; }
+
+        uint64_t messages() const { return delay_.count(); }
+
+        // Messages stamped by the exchange later than our receive time.
+        uint64_t ahead_of_local_clock() const { return ahead_.load(std::memory_order_relaxed); }
+
+    private:
+        LatencyHistogram delay_;
+        LatencyHistogram jitter_;
+        std::atomic<uint64_t> ahead_{0};
+        int64_t last_exchange_ns_ = 0;      // writer only
+        int64_t last_receive_ns_ = 0;
+    };
+}
+
+#endif //FEED_LATENCY_H
@@ -0,0 +1,109 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef FEED_RECORDER_H
+#define FEED_RECORDER_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace deribit {
+
+    // One received WebSocket frame and when it arrived (steady clock, ns).
+    struct RecordedFrame {
+        int64_t receive_ns = 0;
+        std::string payload;
+    };
+
+    // Writes raw frames as they arrive so a session can be replayed later
+    // (bench_pipeline). One frame per line: "<receive_ns> <payload>". Deribit
+    // frames are single-line JSON, so no escaping is needed.
+    class FeedRecorder {
+    public:
+        void open(const std::string& path) {
+            out_.open(path, std::ios::out | std::ios::trunc);
+            if (!out_.is_open()) {
+                throw std::runtime_error("Failed to open recording file: " + path);
+            }
+            frames_ = 0;
+        }
+
+        void close() {
+            out_.close();
+        }
+
+        bool is_open() const { return out_.is_open(); }
+        size_t frames() const { return frames_; }
+
+        void record(int64_t receive_ns, std::string_view payload) {
+            out_ << receive_ns << ' ';
+            out_.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+            out_ << '\n';
+            ++frames_;
+        }
+
+        static int64_t now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+        std::ofstream out_;
+        size_t frames_ = 0;
+    };
+
+    inline std::vector<RecordedFrame> load_recording(const std::string& path) {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            throw std::runtime_error("Failed to open recording file: " + path);
+        }
+
+        std::vector<RecordedFrame> frames;
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t space = line.find(' ');
+            if (space == std::string::npos) {
+                continue;
+            }
+            RecordedFrame frame;
+            frame.receive_ns = std::stoll(line.substr(0, space));
+            frame.payload = line.substr(space + 1);
+            frames.push_back(std::move(frame));
+        }
+        return frames;
+    }
+
+    // The instrument a frame is about, or empty if it names none.
+    inline std::string instrument_of(const std::string& payload) {
+        static const std::string key = "\"instrument_name\":\"";
+        size_t start = payload.find(key);
+        if (start == std::string::npos) return {};
+        start += key.size();
+        size_t end = payload.find('"', start);
+        if (end == std::string::npos) return {};
+        return payload.substr(start, end - start);
+    }
+
+    // Instrument names in a recording, in order of first appearance, so books
+    // can be registered before it is replayed.
+    inline std::vector<std::string> instruments_in(const std::vector<RecordedFrame>& frames) {
+        std::unordered_set<std::string> seen;
+        std::vector<std::string> names;
+        for (const RecordedFrame& frame : frames) {
+            std::string name = instrument_of(frame.payload);
+            if (!name.empty() && seen.insert(name).second) {
+                names.push_back(std::move(name));
+            }
+        }
+        return names;
+    }
+}
+
+#endif //FEED_RECORDER_H
@@ -0,0 +1,131 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef FEED_SIMULATOR_H
+#define FEED_SIMULATOR_H
+
+#include "feed_recorder.hpp"
+
+#include <websocketpp/config/asio.hpp>
+#include <websocketpp/server.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace deribit {
+
+    struct FeedSimulatorOptions {
+        uint16_t port = 9000;               // 0 = any free port, see port()
+        std::string cert_file;              // PEM; with key_file the simulator serves wss://, otherwise ws://
+        std::string key_file;
+        size_t max_buffered = 4 << 20;      // bytes queued on a connection before the sender waits for it
+        bool restamp = true;                // replace "timestamp" with the send time, so feed delay stays meaningful
+    };
+
+    // How stream() paces the corpus. Frames go out in bursts of `burst` back to
+    // back, one burst every burst / rate seconds on a fixed schedule: a sender
+    // that falls behind catches up rather than shifting the schedule, so the
+    // offered load stays what was asked for.
+    struct StreamProfile {
+        double rate = 10000.0;              // frames per second; 0 = as fast as the sockets drain
+        size_t burst = 1;
+        size_t frames = 0;                  // 0 = the whole corpus
+    };
+
+    struct StreamResult {
+        size_t frames = 0;                  // corpus frames walked
+        size_t sent = 0;                    // frames written, summed over subscribers
+        size_t send_errors = 0;
+        size_t stalls = 0;                  // waits for a connection's send buffer to drain
+        int64_t elapsed_ns = 0;
+
+        double frames_per_second() const {
+            return elapsed_ns > 0 ? static_cast<double>(frames) * 1e9 / static_cast<double>(elapsed_ns) : 0.0;
+        }
+    };
+
+    // A local stand-in for the Deribit market data WebSocket. It answers
+    // public/subscribe and public/unsubscribe the way Deribit does and streams
+    // a recorded or synthetic corpus (FeedRecorder frames) to every connection
+    // subscribed to the frame's instrument, whatever the channel interval.
+    // Point Config::ws_url at url() to run DeribitClient against it.
+    //
+    // The corpus is replayed as is, once per stream(); change_id chains restart
+    // with it, so a client that stays connected across two streams sees a gap.
+    class FeedSimulator {
+    public:
+        using SendCallback = std::function<void(size_t frame, int64_t ticks)>;
+
+        explicit FeedSimulator(std::vector<RecordedFrame> frames, FeedSimulatorOptions options = FeedSimulatorOptions{});
+        ~FeedSimulator();
+
+        FeedSimulator(const FeedSimulator&) = delete;
+        FeedSimulator& operator=(const FeedSimulator&) = delete;
+
+        // Listens and serves on a background thread. Throws if it cannot.
+        void start();
+        void stop();
+
+        uint16_t port() const { return port_; }
+        bool secure() const { return secure_; }
+        std::string url() const;
+
+        // Instruments subscribed, summed over connections.
+        size_t subscriptions() const;
+        bool wait_for_subscriptions(size_t count, int64_t timeout_ms) const;
+
+        // Streams the corpus to the current subscribers and returns when the
+        // last frame is handed to the sockets. `on_send` sees each frame's
+        // index and the TscClock ticks just before its first send.
+        StreamResult stream(const StreamProfile& profile, const SendCallback& on_send = nullptr);
+
+        const std::vector<RecordedFrame>& frames() const { return frames_; }
+
+    private:
+        using plain_server = websocketpp::server<websocketpp::config::asio>;
+        using tls_server = websocketpp::server<websocketpp::config::asio_tls>;
+        using connection_hdl = websocketpp::connection_hdl;
+
+        template<typename Server>
+        void init_server(Server& server);
+
+        template<typename Server>
+        StreamResult stream_on(Server& server, const StreamProfile& profile, const SendCallback& on_send);
+
+        template<typename Fn>
+        void with_server(Fn&& fn) {
+            if (secure_) {
+                fn(tls_);
+            } else {
+                fn(plain_);
+            }
+        }
+
+        // The JSON-RPC reply to one client request.
+        std::string handle_request(connection_hdl hdl, const std::string& payload);
+
+        std::vector<RecordedFrame> frames_;
+        std::vector<std::string> instruments_;      // per frame; empty for non-book frames
+        FeedSimulatorOptions options_;
+        bool secure_;
+        uint16_t port_ = 0;
+
+        plain_server plain_;
+        tls_server tls_;
+        std::thread thread_;
+        std::atomic<bool> running_{false};
+
+        mutable std::mutex mutex_;
+        std::map<connection_hdl, std::unordered_set<std::string>, std::owner_less<connection_hdl>> subscribers_;
+    };
+}
+
+#endif //FEED_SIMULATOR_H
@@ -0,0 +1,118 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef INSTRUMENT_REGISTRY_H
+#define INSTRUMENT_REGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace deribit {
+
+    using InstrumentId = uint32_t;
+    constexpr InstrumentId kInvalidInstrument = std::numeric_limits<InstrumentId>::max();
+
+    // Hands out dense integer ids for instrument names.
+    //
+    // Interning happens on the cold path (subscribe, configuration) under a
+    // mutex. Lookups are lock-free and allocation-free, so the feed thread can
+    // resolve the name it just decoded straight to an array index. Ids are never
+    // reused or removed.
+    class InstrumentRegistry {
+    public:
+        static constexpr size_t kMaxInstruments = 1024;
+
+        InstrumentRegistry() : entries_(kMaxInstruments), count_(0) {
+            for (auto& slot : table_) slot.store(0, std::memory_order_relaxed);
+        }
+
+        InstrumentRegistry(const InstrumentRegistry&) = delete;
+        InstrumentRegistry& operator=(const InstrumentRegistry&) = delete;
+
+        // Returns the existing id for `name`, or assigns the next one.
+        InstrumentId intern(std::string_view name) {
+            std::lock_guard<std::mutex> lock(write_mutex_);
+
+            InstrumentId existing = find(name);
+            if (existing != kInvalidInstrument) {
+                return existing;
+            }
+
+            size_t id = count_.load(std::memory_order_relaxed);
+            if (id >= kMaxInstruments) {
+                throw std::runtime_error("InstrumentRegistry: too many instruments");
+            }
+
+            uint64_t hash = hash_name(name);
+            entries_[id].name.assign(name.data(), name.size());
+            entries_[id].hash = hash;
+
+            // Publish: the entry is fully written before its id becomes visible.
+            size_t i = hash & kTableMask;
+            while (table_[i].load(std::memory_order_relaxed) != 0) {
+                i = (i + 1) & kTableMask;
+            }
+            table_[i].store(static_cast<uint32_t>(id + 1), std::memory_order_release);
+            count_.store(id + 1, std::memory_order_release);
+
+            return static_cast<InstrumentId>(id);
+        }
+
+        InstrumentId find(std::string_view name) const {
+            uint64_t hash = hash_name(name);
+            for (size_t i = hash & kTableMask;; i = (i + 1) & kTableMask) {
+                uint32_t v = table_[i].load(std::memory_order_acquire);
+                if (v == 0) {
+                    return kInvalidInstrument;
+                }
+                const Entry& entry = entries_[v - 1];
+                if (entry.hash == hash && entry.name == name) {
+                    return v - 1;
+                }
+            }
+        }
+
+        // Only valid for ids returned by intern()/find().
+        const std::string& name(InstrumentId id) const {
+            return entries_[id].name;
+        }
+
+        size_t size() const {
+            return count_.load(std::memory_order_acquire);
+        }
+
+    private:
+        // Twice the id space keeps probe chains short.
+        static constexpr size_t kTableSize = kMaxInstruments * 2;
+        static constexpr size_t kTableMask = kTableSize - 1;
+
+        struct Entry {
+            std::string name;
+            uint64_t hash = 0;
+        };
+
+        // FNV-1a; instrument names are short.
+        static uint64_t hash_name(std::string_view name) {
+            uint64_t h = 1469598103934665603ULL;
+            for (char c : name) {
+                h ^= static_cast<unsigned char>(c);
+                h *= 1099511628211ULL;
+            }
+            return h;
+        }
+
+        std::vector<Entry> entries_;                // sized once, never reallocated
+        std::atomic<uint32_t> table_[kTableSize];   // id + 1, 0 = empty
+        std::atomic<size_t> count_;
+        std::mutex write_mutex_;
+    };
+}
+
+#endif //INSTRUMENT_REGISTRY_H
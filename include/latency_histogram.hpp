@@ -0,0 +1,203 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace deribit {
+
+    // Log-linear bucketing in the style of HdrHistogram. Values below
+    // kSubBuckets get a bucket each; above that, every power of two is split
+    // into kSubBuckets equal buckets, so a bucket is never wider than
+    // 1/kSubBuckets of the values in it. Reporting the bucket midpoint keeps
+    // every percentile within kMaxRelativeError of the true value, at any
+    // sample count and in fixed memory.
+    struct HistogramLayout {
+        static constexpr unsigned kSubBucketBits = 6;
+        static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+        static constexpr unsigned kValueBits = 40;     // ~18 minutes in ns, ~6 in 3 GHz TSC ticks
+        static constexpr uint64_t kMaxValue = (uint64_t{1} << kValueBits) - 1;
+        static constexpr size_t kBuckets = (kValueBits - kSubBucketBits + 1) * kSubBuckets;
+        static constexpr double kMaxRelativeError = 0.5 / kSubBuckets;
+
+        // Larger values are counted in the last bucket.
+        static size_t bucket_of(uint64_t value) {
+            value = std::min(value, kMaxValue);
+            if (value < kSubBuckets) {
+                return static_cast<size_t>(value);
+            }
+            unsigned shift = static_cast<unsigned>(63 - __builtin_clzll(value)) - kSubBucketBits;
+            return static_cast<size_t>((shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets));
+        }
+
+        static uint64_t bucket_low(size_t bucket) {
+            if (bucket < kSubBuckets) {
+                return bucket;
+            }
+            unsigned shift = static_cast<unsigned>(bucket / kSubBuckets) - 1;
+            return (kSubBuckets + bucket % kSubBuckets) << shift;
+        }
+
+        static uint64_t bucket_width(size_t bucket) {
+            return bucket < kSubBuckets ? 1 : uint64_t{1} << (bucket / kSubBuckets - 1);
+        }
+    };
+
+    // Plain-value copy of a histogram. Snapshots from different threads
+    // merge(); two snapshots of the same histogram taken at different times
+    // give the window between them through since().
+    class HistogramSnapshot {
+    public:
+        HistogramSnapshot() : counts_(HistogramLayout::kBuckets, 0) {}
+
+        uint64_t count() const { return count_; }
+        uint64_t sum() const { return sum_; }
+        uint64_t min() const { return count_ ? min_ : 0; }
+        uint64_t max() const { return max_; }
+        uint64_t mean() const { return count_ ? sum_ / count_ : 0; }
+
+        // Smallest recorded value v such that `percentile` % of the samples
+        // are <= v, to within HistogramLayout::kMaxRelativeError.
+        uint64_t percentile(double percentile) const {
+            if (count_ == 0) {
+                return 0;
+            }
+            auto rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(count_) + 0.5);
+            rank = std::clamp<uint64_t>(rank, 1, count_);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < counts_.size(); ++i) {
+                seen += counts_[i];
+                if (seen >= rank) {
+                    uint64_t mid = HistogramLayout::bucket_low(i) + HistogramLayout::bucket_width(i) / 2;
+                    return std::clamp(mid, min(), max_);
+                }
+            }
+            return max_;
+        }
+
+        HistogramSnapshot& merge(const HistogramSnapshot& other) {
+            if (other.count_ == 0) {
+                return *this;
+            }
+            for (size_t i = 0; i < counts_.size(); ++i) {
+                counts_[i] += other.counts_[i];
+            }
+            min_ = count_ ? std::min(min_, other.min_) : other.min_;
+            max_ = std::max(max_, other.max_);
+            count_ += other.count_;
+            sum_ += other.sum_;
+            return *this;
+        }
+
+        // What was recorded after `earlier` (an older snapshot of the same
+        // histogram). min/max are known only to bucket precision here.
+        HistogramSnapshot since(const HistogramSnapshot& earlier) const {
+            HistogramSnapshot window;
+            for (size_t i = 0; i < counts_.size(); ++i) {
+                uint64_t n = counts_[i] - std::min(counts_[i], earlier.counts_[i]);
+                if (n == 0) {
+                    continue;
+                }
+                window.counts_[i] = n;
+                window.count_ += n;
+                if (window.count_ == n) {
+                    window.min_ = std::max(HistogramLayout::bucket_low(i), min());
+                }
+                window.max_ = std::min(HistogramLayout::bucket_low(i) + HistogramLayout::bucket_width(i) - 1, max_);
+            }
+            window.sum_ = sum_ - std::min(sum_, earlier.sum_);
+            return window;
+        }
+
+    private:
+        friend class LatencyHistogram;
+
+        std::vector<uint64_t> counts_;
+        uint64_t count_ = 0;
+        uint64_t sum_ = 0;
+        uint64_t min_ = 0;
+        uint64_t max_ = 0;
+    };
+
+    // Histogram with a single writer and any number of readers. Recording is
+    // a bucket index computation and a few relaxed stores to memory only the
+    // writer touches; nothing is shared, locked or allocated. snapshot() may
+    // run concurrently and sees each counter either before or after a write.
+    // Off the hot path, record_concurrent() lets several threads share one.
+    class LatencyHistogram {
+    public:
+        LatencyHistogram() = default;
+        LatencyHistogram(const LatencyHistogram&) = delete;
+        LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+        // Writer only.
+        void record(uint64_t value) {
+            bump(counts_[HistogramLayout::bucket_of(value)], 1);
+            bump(sum_, value);
+            if (value > max_.load(std::memory_order_relaxed)) {
+                max_.store(value, std::memory_order_relaxed);
+            }
+            if (value < min_.load(std::memory_order_relaxed)) {
+                min_.store(value, std::memory_order_relaxed);
+            }
+            bump(count_, 1);
+        }
+
+        // Any thread, with atomic read-modify-writes; for low-rate events
+        // (order round trips) where a histogram per thread is not worth it.
+        // Do not mix with record() on the same histogram.
+        void record_concurrent(uint64_t value) {
+            counts_[HistogramLayout::bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+            sum_.fetch_add(value, std::memory_order_relaxed);
+            uint64_t seen = max_.load(std::memory_order_relaxed);
+            while (value > seen && !max_.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+            }
+            seen = min_.load(std::memory_order_relaxed);
+            while (value < seen && !min_.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+            }
+            count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void snapshot_into(HistogramSnapshot& out) const {
+            // Buckets are summed as read rather than trusting count_, so the
+            // percentiles are consistent with the counts they came from.
+            out.count_ = 0;
+            for (size_t i = 0; i < HistogramLayout::kBuckets; ++i) {
+                out.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+                out.count_ += out.counts_[i];
+            }
+            out.sum_ = sum_.load(std::memory_order_relaxed);
+            out.max_ = max_.load(std::memory_order_relaxed);
+            out.min_ = out.count_ ? std::min(min_.load(std::memory_order_relaxed), out.max_) : 0;
+        }
+
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+        HistogramSnapshot snapshot() const {
+            HistogramSnapshot out;
+            snapshot_into(out);
+            return out;
+        }
+
+    private:
+        static void bump(std::atomic<uint64_t>& counter, uint64_t by) {
+            counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<uint64_t>, HistogramLayout::kBuckets> counts_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> min_{UINT64_MAX};
+        std::atomic<uint64_t> max_{0};
+    };
+}
+
+#endif //LATENCY_HISTOGRAM_H
@@ -5,210 +5,230 @@
 #ifndef LATENCY_METRICS_H
 #define LATENCY_METRICS_H
 
-#include <chrono>
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
 #include <vector>
-#include <algorithm>
-#include <cmath>
-
-namespace deribit {
-
-using Clock = std::chrono::high_resolution_clock;
-using TimePoint = std::chrono::time_point<Clock>;
-using Nanoseconds = std::chrono::nanoseconds;
-
-struct LatencyMeasurement {
-    uint64_t websocket_to_queue_ns = 0;
-    uint64_t queue_to_process_ns = 0;
-    uint64_t process_to_update_ns = 0;
-    uint64_t total_latency_ns = 0;
-
-    TimePoint ws_receive_time;
-    TimePoint queue_push_time;
-    TimePoint worker_pop_time;
-    TimePoint update_complete_time;
-};
-
-// Latency statistics
-struct LatencyStats {
-    uint64_t min_ns = UINT64_MAX;
-    uint64_t max_ns = 0;
-    uint64_t avg_ns = 0;
-    uint64_t p50_ns = 0;  // Median
-    uint64_t p95_ns = 0;
-    uint64_t p99_ns = 0;
-    size_t sample_count = 0;
-};
-
-class LatencyTracker {
-public:
-    LatencyTracker(size_t max_samples = 10000)
-        : max_samples_(max_samples), measurement_count_(0) {
-        latencies_.reserve(max_samples);
-    }
-
-    // Record timestamp at each stage
-    void record_websocket_receive() {
-        current_measurement_.ws_receive_time = Clock::now();
-    }
-
-    void record_queue_push() {
-        current_measurement_.queue_push_time = Clock::now();
-
-        auto ws_to_queue = current_measurement_.queue_push_time - current_measurement_.ws_receive_time;
-        current_measurement_.websocket_to_queue_ns =
-            std::chrono::duration_cast<Nanoseconds>(ws_to_queue).count();
-    }
-
-    void record_worker_pop() {
-        current_measurement_.worker_pop_time = Clock::now();
-
-        auto queue_to_process = current_measurement_.worker_pop_time - current_measurement_.queue_push_time;
-        current_measurement_.queue_to_process_ns =
-            std::chrono::duration_cast<Nanoseconds>(queue_to_process).count();
-    }
-
-    void record_update_complete() {
-        current_measurement_.update_complete_time = Clock::now();
-
-        auto process_to_update = current_measurement_.update_complete_time - current_measurement_.worker_pop_time;
-        current_measurement_.process_to_update_ns =
-            std::chrono::duration_cast<Nanoseconds>(process_to_update).count();
-
-        auto total = current_measurement_.update_complete_time - current_measurement_.ws_receive_time;
-        current_measurement_.total_latency_ns =
-            std::chrono::duration_cast<Nanoseconds>(total).count();
-
-        // Store measurement
-        add_measurement(current_measurement_);
-    }
-
-    // Get statistics
-    LatencyStats get_websocket_to_queue_stats() const {
-        return calculate_stats([](const LatencyMeasurement& m) { return m.websocket_to_queue_ns; });
-    }
-
-    LatencyStats get_queue_to_process_stats() const {
-        return calculate_stats([](const LatencyMeasurement& m) { return m.queue_to_process_ns; });
-    }
-
-    LatencyStats get_process_to_update_stats() const {
-        return calculate_stats([](const LatencyMeasurement& m) { return m.process_to_update_ns; });
-    }
-
-    LatencyStats get_total_latency_stats() const {
-        return calculate_stats([](const LatencyMeasurement& m) { return m.total_latency_ns; });
-    }
-
-    void print_summary() const {
-        auto ws_to_queue = get_websocket_to_queue_stats();
-        auto queue_to_process = get_queue_to_process_stats();
-        auto process_to_update = get_process_to_update_stats();
-        auto total = get_total_latency_stats();
-
-        std::cout << "\n" << std::string(70, '=') << std::endl;
-        std::cout << "LATENCY METRICS SUMMARY" << std::endl;
-        std::cout << std::string(70, '=') << std::endl;
-        std::cout << "Samples: " << measurement_count_.load() << std::endl << std::endl;
-
-        print_stage_stats("WebSocket → Queue", ws_to_queue);
-        print_stage_stats("Queue → Worker", queue_to_process);
-        print_stage_stats("Worker → Update", process_to_update);
-        print_stage_stats("Total (End-to-End)", total);
 
-        std::cout << std::string(70, '=') << std::endl;
-    }
-
-    void reset() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        latencies_.clear();
-        measurement_count_ = 0;
-    }
+#include "latency_histogram.hpp"
+#include "tsc_clock.hpp"
 
-    size_t get_sample_count() const {
-        return measurement_count_.load();
-    }
-
-private:
-    void add_measurement(const LatencyMeasurement& m) {
-        std::lock_guard<std::mutex> lock(mutex_);
+namespace deribit {
 
-        if (latencies_.size() < max_samples_) {
-            latencies_.push_back(m);
-        } else {
-            // Ring buffer behavior - overwrite oldest
-            latencies_[measurement_count_ % max_samples_] = m;
+    // Stages of one book message, in pipeline order.
+    enum class Stage : uint8_t {
+        Decode,         // frame received -> handed to MarketData (decode + routing)
+        QueueWait,      // enqueued -> taken off the queue by a worker
+        Apply,          // taken off the queue -> book updated and published, including
+                        // earlier messages of the same batch
+        Callback,       // strategy callback
+        Total           // frame received -> callback returned
+    };
+
+    constexpr size_t kStageCount = 5;
+
+    inline const char* to_string(Stage stage) {
+        switch (stage) {
+            case Stage::Decode: return "WebSocket -> Queue";
+            case Stage::QueueWait: return "Queue wait";
+            case Stage::Apply: return "Apply + publish";
+            case Stage::Callback: return "Strategy callback";
+            case Stage::Total: return "Total (end-to-end)";
         }
-
-        measurement_count_++;
+        return "unknown";
     }
 
-    template<typename Func>
-    LatencyStats calculate_stats(Func extractor) const {
-        std::lock_guard<std::mutex> lock(mutex_);
-
-        if (latencies_.empty()) {
-            return LatencyStats{};
+    // For metric labels.
+    inline const char* to_label(Stage stage) {
+        switch (stage) {
+            case Stage::Decode: return "decode";
+            case Stage::QueueWait: return "queue_wait";
+            case Stage::Apply: return "apply";
+            case Stage::Callback: return "callback";
+            case Stage::Total: return "total";
+        }
+        return "unknown";
+    }
+
+    // Latency statistics. Percentiles are within
+    // HistogramLayout::kMaxRelativeError; min and max are exact.
+    struct LatencyStats {
+        uint64_t min_ns = 0;
+        uint64_t max_ns = 0;
+        uint64_t avg_ns = 0;
+        uint64_t p50_ns = 0;  // Median
+        uint64_t p90_ns = 0;
+        uint64_t p99_ns = 0;
+        uint64_t p999_ns = 0;
+        uint64_t p9999_ns = 0;
+        size_t sample_count = 0;
+
+        // `h` holds TscClock ticks.
+        static LatencyStats from(const HistogramSnapshot& h) {
+            auto ns = [](uint64_t ticks) {
+                return static_cast<uint64_t>(TscClock::to_ns(static_cast<int64_t>(ticks)));
+            };
+            LatencyStats stats;
+            stats.sample_count = static_cast<size_t>(h.count());
+            stats.min_ns = ns(h.min());
+            stats.max_ns = ns(h.max());
+            stats.avg_ns = ns(h.mean());
+            stats.p50_ns = ns(h.percentile(50.0));
+            stats.p90_ns = ns(h.percentile(90.0));
+            stats.p99_ns = ns(h.percentile(99.0));
+            stats.p999_ns = ns(h.percentile(99.9));
+            stats.p9999_ns = ns(h.percentile(99.99));
+            return stats;
+        }
+    };
+
+    // TscClock timestamps of the message a thread is currently handling; 0 = not reached.
+    struct StageStamps {
+        int64_t receive_ticks = 0;
+        int64_t enqueue_ticks = 0;
+        int64_t dequeue_ticks = 0;
+        int64_t callback_start_ticks = 0;
+        int64_t callback_end_ticks = 0;
+    };
+
+    // Stage latencies from one thread, one histogram per stage. Only the
+    // owning thread writes; any thread may read. Recording is O(1) and takes
+    // no lock, and every sample since startup is kept. Histograms hold
+    // TscClock ticks; they are converted to nanoseconds when read.
+    class StageRecorder {
+    public:
+        explicit StageRecorder(std::string name) : name_(std::move(name)) {}
+
+        StageRecorder(const StageRecorder&) = delete;
+        StageRecorder& operator=(const StageRecorder&) = delete;
+
+        const std::string& name() const { return name_; }
+
+        // Owner only: the message being handled right now.
+        StageStamps current;
+
+        void record(Stage stage, int64_t ticks) {
+            histograms_[static_cast<size_t>(stage)].record(static_cast<uint64_t>(std::max<int64_t>(ticks, 0)));
         }
 
-        std::vector<uint64_t> values;
-        values.reserve(latencies_.size());
-
-        for (const auto& m : latencies_) {
-            values.push_back(extractor(m));
+        // Records every stage whose start and end were both stamped.
+        void record(const StageStamps& s) {
+            if (s.receive_ticks && s.enqueue_ticks) record(Stage::Decode, s.enqueue_ticks - s.receive_ticks);
+            if (s.enqueue_ticks && s.dequeue_ticks) record(Stage::QueueWait, s.dequeue_ticks - s.enqueue_ticks);
+            if (s.dequeue_ticks && s.callback_start_ticks) record(Stage::Apply, s.callback_start_ticks - s.dequeue_ticks);
+            if (s.callback_start_ticks && s.callback_end_ticks) record(Stage::Callback, s.callback_end_ticks - s.callback_start_ticks);
+            if (s.receive_ticks && s.callback_end_ticks) record(Stage::Total, s.callback_end_ticks - s.receive_ticks);
         }
 
-        std::sort(values.begin(), values.end());
+        const LatencyHistogram& histogram(Stage stage) const {
+            return histograms_[static_cast<size_t>(stage)];
+        }
 
-        LatencyStats stats;
-        stats.sample_count = values.size();
-        stats.min_ns = values.front();
-        stats.max_ns = values.back();
+    private:
+        std::string name_;
+        std::array<LatencyHistogram, kStageCount> histograms_;
+    };
+
+    // Per-stage latency across every thread of a pipeline. Each thread records
+    // into its own StageRecorder, so the write path shares nothing; reading
+    // merges their histograms. The mutex only guards the list of recorders
+    // and the baseline. For a time window, keep an earlier snapshot() and take
+    // since() on it.
+    class LatencyTracker {
+    public:
+        // One per recording thread; it lives as long as the tracker.
+        StageRecorder* add_recorder(const std::string& name) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            recorders_.push_back(std::make_unique<StageRecorder>(name));
+            return recorders_.back().get();
+        }
 
-        uint64_t sum = 0;
-        for (auto v : values) sum += v;
-        stats.avg_ns = sum / values.size();
+        // In TscClock ticks.
+        HistogramSnapshot snapshot(Stage stage) const {
+            HistogramSnapshot merged;
+            HistogramSnapshot part;
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& recorder : recorders_) {
+                recorder->histogram(stage).snapshot_into(part);
+                merged.merge(part);
+            }
+            return has_baseline_ ? merged.since(baseline_[static_cast<size_t>(stage)]) : merged;
+        }
 
-        stats.p50_ns = values[values.size() * 50 / 100];
-        stats.p95_ns = values[values.size() * 95 / 100];
-        stats.p99_ns = values[values.size() * 99 / 100];
+        // Leaves everything recorded so far out of snapshot() and stats() from
+        // now on (e.g. the warm-up feed). The recorders keep their samples;
+        // only what is reported changes, so readers still see counts that
+        // never go down.
+        void set_baseline() {
+            std::array<HistogramSnapshot, kStageCount> merged;
+            HistogramSnapshot part;
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < kStageCount; ++i) {
+                for (const auto& recorder : recorders_) {
+                    recorder->histogram(static_cast<Stage>(i)).snapshot_into(part);
+                    merged[i].merge(part);
+                }
+            }
+            baseline_ = std::move(merged);
+            has_baseline_ = true;
+        }
 
-        return stats;
-    }
+        LatencyStats stats(Stage stage) const {
+            return LatencyStats::from(snapshot(stage));
+        }
 
-    void print_stage_stats(const std::string& name, const LatencyStats& stats) const {
-        std::cout << name << ":" << std::endl;
-        std::cout << "  Min:    " << format_latency(stats.min_ns) << std::endl;
-        std::cout << "  Avg:    " << format_latency(stats.avg_ns) << std::endl;
-        std::cout << "  Median: " << format_latency(stats.p50_ns) << std::endl;
-        std::cout << "  p95:    " << format_latency(stats.p95_ns) << std::endl;
-        std::cout << "  p99:    " << format_latency(stats.p99_ns) << std::endl;
-        std::cout << "  Max:    " << format_latency(stats.max_ns) << std::endl;
-        std::cout << std::endl;
-    }
+        void print_summary(std::ostream& out) const {
+            print_latency_header(out, "Stage");
+            for (size_t i = 0; i < kStageCount; ++i) {
+                Stage stage = static_cast<Stage>(i);
+                print_latency_row(out, to_string(stage), stats(stage));
+            }
+        }
 
-    std::string format_latency(uint64_t ns) const {
-        if (ns < 1000) {
-            return std::to_string(ns) + " ns";
-        } else if (ns < 1000000) {
-            return std::to_string(ns / 1000) + "." + std::to_string((ns % 1000) / 100) + " μs";
-        } else {
-            return std::to_string(ns / 1000000) + "." + std::to_string((ns % 1000000) / 100000) + " ms";
+        static std::string format_latency(uint64_t ns) {
+            if (ns < 1000) {
+                return std::to_string(ns) + " ns";
+            } else if (ns < 1000000) {
+                return std::to_string(ns / 1000) + "." + std::to_string((ns % 1000) / 100) + " us";
+            } else {
+                return std::to_string(ns / 1000000) + "." + std::to_string((ns % 1000000) / 100000) + " ms";
+            }
         }
-    }
 
-    size_t max_samples_;
-    std::vector<LatencyMeasurement> latencies_;
-    mutable std::mutex mutex_;
-    std::atomic<size_t> measurement_count_;
+        // The percentile table print_summary() uses, for other histograms.
+        static void print_latency_header(std::ostream& out, const char* first_column) {
+            out << std::left << std::setw(20) << first_column << std::right << std::setw(10) << "Samples";
+            for (const char* column : {"p50", "p90", "p99", "p99.9", "p99.99", "Max"}) {
+                out << std::setw(10) << column;
+            }
+            out << std::endl;
+        }
 
-    // Thread-local current measurement
-    thread_local static LatencyMeasurement current_measurement_;
-};
+        static void print_latency_row(std::ostream& out, const char* name, const LatencyStats& s) {
+            out << std::left << std::setw(20) << name << std::right << std::setw(10) << s.sample_count;
+            if (s.sample_count == 0) {
+                out << std::setw(10) << "-" << std::endl;
+                return;
+            }
+            for (uint64_t ns : {s.p50_ns, s.p90_ns, s.p99_ns, s.p999_ns, s.p9999_ns, s.max_ns}) {
+                out << std::setw(10) << format_latency(ns);
+            }
+            out << std::endl;
+        }
 
-// Thread-local storage for current measurement
-thread_local LatencyMeasurement LatencyTracker::current_measurement_;
+    private:
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<StageRecorder>> recorders_;
+        std::array<HistogramSnapshot, kStageCount> baseline_;
+        bool has_baseline_ = false;
+    };
 
 } // namespace deribit
 
-#endif // LATENCY_METRICS_H
\ No newline at end of file
+#endif // LATENCY_METRICS_H
@@ -8,22 +8,49 @@
 #include <string>
 #include <map>
 #include <iostream>
+#include <iomanip>
 #include <set>
 #include <mutex>
+#include <future>
+#include <condition_variable>
 #include <functional>
-#include <json/json.h>
 #include <unordered_map>
 #include <vector>
 #include <thread>
 #include <atomic>
 #include <optional>
 #include <chrono>
+#include <memory>
+#include <memory_resource>
+#include <algorithm>
+#include <stdexcept>
+
+#include <array>
 
 #include "buffer.hpp"
+#include "book_update.hpp"
+#include "price_ladder.hpp"
+#include "seqlock.hpp"
+#include "epoch.hpp"
+#include "instrument_registry.hpp"
+#include "wait_strategy.hpp"
+#include "thread_topology.hpp"
+#include "scratch_arena.hpp"
+#include "latency_metrics.hpp"
+#include "feed_latency.hpp"
+#include "tick_to_trade.hpp"
+#include "event_trace.hpp"
 
 namespace deribit {
 
     struct Orderbook {
+        Orderbook() = default;
+
+        // Ladder overflow nodes are allocated from `levels` (see BookSlot).
+        explicit Orderbook(std::pmr::memory_resource* levels)
+            : bids(BidLadder::kDefaultTickSize, BidLadder::kDefaultWindow, levels),
+              asks(AskLadder::kDefaultTickSize, AskLadder::kDefaultWindow, levels) {}
+
         std::string instrument_name;
         int64_t timestamp = 0;
         int64_t change_id = 0;
@@ -31,59 +58,363 @@ namespace deribit {
         double best_bid_amount = 0.0;
         double best_ask_price = 0.0;
         double best_ask_amount = 0.0;
-        std::map<double,double> bids;
-        std::map<double,double> asks;
+        bool stale = false;             // sequence gap detected; waiting for a resync snapshot
+        TraceContext trace;             // feed message behind the latest change (writer's book only)
+        BidLadder bids;
+        AskLadder asks;
+    };
+
+    // Best bid/ask only. Published through a seqlock after every update.
+    struct TopOfBook {
+        int64_t timestamp = 0;
+        int64_t change_id = 0;
+        double best_bid_price = 0.0;
+        double best_bid_amount = 0.0;
+        double best_ask_price = 0.0;
+        double best_ask_amount = 0.0;
+        bool stale = false;
+    };
+
+    struct PriceLevel {
+        double price = 0.0;
+        double amount = 0.0;
+    };
+
+    // Immutable top-N view of a book. Published after every update and
+    // recycled through epoch-based reclamation, so neither side allocates.
+    struct DepthSnapshot {
+        static constexpr size_t kMaxLevels = 20;
+
+        int64_t timestamp = 0;
+        int64_t change_id = 0;
+        double tick_size = 0.0;
+        bool stale = false;
+        size_t bid_count = 0;
+        size_t ask_count = 0;
+        std::array<PriceLevel, kMaxLevels> bids{};     // best first
+        std::array<PriceLevel, kMaxLevels> asks{};     // best first
     };
 
     using OrderBookUpdateCallback = std::function<void(const std::string&, const Orderbook&)>;
 
+    // Asked to fetch a fresh snapshot for a book that lost sequence. Called from
+    // a worker thread, so it must not block; the result comes back through
+    // MarketData::submit_snapshot().
+    using ResyncHandler = std::function<void(InstrumentId, const std::string&)>;
+
+    enum class RoutingMode {
+        Shared,     // one worker pops from a queue shared by every symbol (more than one
+                    // would apply a symbol's updates out of order, so it is rejected)
+        Sharded,    // each symbol is pinned to one worker, which owns a private SPSC ring
+        Inline      // no workers: the feed thread applies and runs the callback itself
+    };
+
+    // One worker queue as seen by a metrics reader. high_water is the deepest
+    // backlog a worker found when it drained the queue.
+    struct QueueMetrics {
+        size_t depth = 0;
+        size_t high_water = 0;
+        size_t capacity = 0;
+    };
+
+    // What enqueue_orderbook_update() does when the worker queue is full.
+    enum class BackpressureMode {
+        Drop,       // discard the update and count it; the book is wrong until the next snapshot
+        Conflate    // merge the instrument's updates into one net change until the queue has room
+    };
+
     class MarketData {
     public:
-        MarketData(size_t num_workers = 4, size_t queue_size = 65536)
-            : queue_(queue_size), running_(true), dropped_messages_(0),
-              total_updates_(0), total_latency_ns_(0)
+        // `wait` is what a worker does when its queue is empty (see WaitStrategy).
+        // Sharded is the default because it keeps each instrument's updates in
+        // change_id order. Shared with more than one worker does not, and gap
+        // detection would read the reordering as lost messages and resync, so
+        // Shared takes exactly one worker (std::invalid_argument otherwise).
+        MarketData(size_t num_workers = 4, size_t queue_size = 65536, RoutingMode mode = RoutingMode::Sharded,
+                   BackpressureMode backpressure = BackpressureMode::Drop, const WaitConfig& wait = WaitConfig{})
+            : routing_mode_(mode), backpressure_(backpressure), books_(InstrumentRegistry::kMaxInstruments),
+              queue_(mode == RoutingMode::Shared ? queue_size : 2), shared_wait_(wait),
+              running_(true), dropped_messages_(0), total_updates_(0), total_processing_ticks_(0),
+              inline_stages_(mode == RoutingMode::Inline ? latency_.add_recorder("inline") : nullptr)
         {
-            for (size_t i = 0; i < num_workers; ++i) {
-                workers_.emplace_back([this] { this->worker_loop(); });
+            if (mode == RoutingMode::Shared && num_workers > 1) {
+                throw std::invalid_argument("MarketData: RoutingMode::Shared takes one worker; use Sharded for more");
+            }
+            for (auto& slot : books_) {
+                slot.store(nullptr, std::memory_order_relaxed);
+            }
+            if (num_workers == 0) num_workers = 1;
+
+            ThreadTopology& topology = ThreadTopology::global();
+            if (routing_mode_ == RoutingMode::Sharded) {
+                // Each worker pins itself and then builds its own shard, so the
+                // ring is first touched (and placed) on the worker's NUMA node.
+                shards_.resize(num_workers);
+                std::mutex ready_mutex;
+                std::condition_variable ready_cv;
+                size_t ready = 0;
+                for (size_t i = 0; i < num_workers; ++i) {
+                    workers_.emplace_back([&, i, queue_size, wait] {
+                        topology.pin_current_thread(ThreadRole::BookShard, i, "md-shard-" + std::to_string(i));
+                        auto shard = std::make_unique<Shard>(i, queue_size, wait);
+                        Shard* s = shard.get();
+                        {
+                            std::lock_guard<std::mutex> lock(ready_mutex);
+                            shards_[i] = std::move(shard);
+                            ++ready;
+                            ready_cv.notify_all();
+                        }
+                        current_stages_ = latency_.add_recorder("md-shard-" + std::to_string(i));
+                        this->shard_loop(*s);
+                    });
+                }
+                std::unique_lock<std::mutex> lock(ready_mutex);
+                ready_cv.wait(lock, [&] { return ready == num_workers; });
+            } else if (routing_mode_ == RoutingMode::Shared) {
+                for (size_t i = 0; i < num_workers; ++i) {
+                    workers_.emplace_back([this, &topology, i] {
+                        topology.pin_current_thread(ThreadRole::BookShard, i, "md-worker-" + std::to_string(i));
+                        current_stages_ = latency_.add_recorder("md-worker-" + std::to_string(i));
+                        this->worker_loop();
+                    });
+                }
             }
         }
 
         ~MarketData() {
             running_ = false;
+            shared_wait_.wake_all();
+            for (auto& shard : shards_) {
+                shard->wait.wake_all();
+            }
             for (auto& t : workers_) {
                 if (t.joinable()) t.join();
             }
+            for (auto& slot : books_) {
+                delete slot.load(std::memory_order_relaxed);
+            }
         }
 
-        // NEW: Accept Json::Value by rvalue reference (move semantics)
-        void enqueue_orderbook_update(const std::string& symbol, Json::Value&& payload) {
-            // Try to push, if queue is full, drop the message instead of blocking
-            if (!queue_.push({symbol, std::move(payload)})) {
-                // Queue is full - drop message and track it
+        // Interns the symbol and creates its book. Must happen before the feed
+        // can deliver updates for it (DeribitClient::subscribe does this).
+        InstrumentId register_instrument(const std::string& symbol);
+
+        const InstrumentRegistry& instruments() const { return instruments_; }
+
+        // Startup only, before subscribing. Faults in the queue rings (asking
+        // for transparent huge pages with `huge_pages`) and reserves `levels`
+        // levels per side in every queued BookUpdate, every worker's drain
+        // batch and the conflation storage of books registered afterwards, so
+        // none of them grow on the tick path. Sharded rings and each shard
+        // worker's scratch arena are touched by that worker, keeping them on
+        // its NUMA node.
+        void prepare_memory(bool huge_pages, size_t levels);
+
+        // Called from the WebSocket thread with an already-decoded book message.
+        // There must be a single caller: in sharded mode each shard ring is SPSC.
+        // The feed never waits for queue room: if the queue is full the message
+        // is either dropped or conflated, depending on the BackpressureMode.
+        // Conflating takes the instrument's Conflation::mutex, which a worker
+        // holds only while it copies the merged update out (take_conflated), so
+        // the feed can wait that long behind it, and only for that instrument.
+        //
+        // In RoutingMode::Inline the update is applied, published and handed to
+        // the update callback right here, with no queue and no lock; the caller
+        // is the only writer of every book.
+        //
+        // Stamps update.enqueue_ticks; set update.receive_ticks beforehand (when the
+        // frame arrived) for the stage breakdown to include decode and total.
+        void enqueue_orderbook_update(BookUpdate& update) {
+            update.enqueue_ticks = TscClock::now();
+            BookSlot* slot = slot_for(update.instrument_id);
+            if (!slot) {
+                return;     // not an instrument we registered
+            }
+
+            if (routing_mode_ == RoutingMode::Inline) {
+                drain_inbox(shared_inbox_);     // resync snapshots, applied on this thread too
+                // No queue: the wait is recorded as zero and apply starts at enqueue.
+                current_stages_ = inline_stages_;
+                inline_stages_->current = StageStamps{update.receive_ticks, update.enqueue_ticks, update.enqueue_ticks, 0, 0};
+                EventTracer::record(TraceEvent::Dequeued, update.trace_id, update.instrument_id, update.enqueue_ticks);
+                apply_update(*slot, update);
+                EventTracer::record(TraceEvent::Applied, update.trace_id, update.instrument_id);
+                record_processing(update.enqueue_ticks, 1);
+                finish_stages(*inline_stages_);
+                current_stages_ = nullptr;
+                return;
+            }
+
+            if (!pending_markers_.empty()) {
+                retry_conflation_markers();
+            }
+            // Once an instrument is conflating, everything for it is merged until
+            // a worker takes the merged update, so nothing overtakes it.
+            if (slot->conflation.active.load(std::memory_order_acquire) && conflate(*slot, update)) {
+                return;
+            }
+            if (push_to_worker(*slot, update)) {
+                return;
+            }
+            if (backpressure_ == BackpressureMode::Conflate) {
+                begin_conflation(*slot, update);
+            } else {
                 dropped_messages_.fetch_add(1, std::memory_order_relaxed);
-                // Optionally log (but don't spam console in production)
-                // std::cerr << "WARNING: Dropped message for " << symbol << std::endl;
             }
         }
 
-        // Keep backward compatibility with const& (will make a copy, but at least no busy-wait)
-        void enqueue_orderbook_update(const std::string& symbol, const Json::Value& payload) {
-            if (!queue_.push({symbol, payload})) {
-                dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+        // Hand a resync snapshot (e.g. from REST) to the worker that owns the book.
+        // Safe to call from any thread. Buffered deltas are replayed on top of it.
+        void submit_snapshot(BookUpdate&& snapshot) {
+            BookSlot* slot = slot_for(snapshot.instrument_id);
+            if (!slot) {
+                return;
             }
+            bool sharded = (routing_mode_ == RoutingMode::Sharded);
+            Shard* shard = sharded ? shards_[slot->shard.load(std::memory_order_relaxed)].get() : nullptr;
+            Inbox& inbox = sharded ? shard->inbox : shared_inbox_;
+            {
+                std::lock_guard<std::mutex> lock(inbox.mutex);
+                inbox.items.push_back(std::move(snapshot));
+                inbox.pending.store(true, std::memory_order_release);
+            }
+            (sharded ? shard->wait : shared_wait_).notify();
+        }
+
+        // Called with the book after every applied update, on the thread that
+        // applied it (a worker, or the feed thread in RoutingMode::Inline).
+        // Set it before subscribing; it is not synchronised with the workers.
+        void set_update_callback(OrderBookUpdateCallback callback) {
+            update_callback_ = std::move(callback);
+        }
+
+        void set_resync_handler(ResyncHandler handler) {
+            std::lock_guard<std::mutex> lock(resync_mutex_);
+            resync_handler_ = std::move(handler);
+        }
+
+        // Pin a symbol to a shard instead of hashing it. Call before subscribing
+        // so that no update for the symbol is already queued on another shard.
+        void assign_shard(const std::string& symbol, size_t shard) {
+            BookSlot* slot = slot_for(register_instrument(symbol));
+            slot->shard.store(static_cast<uint32_t>(shard % std::max<size_t>(shards_.size(), 1)),
+                              std::memory_order_relaxed);
+        }
+
+        // Most updates a worker takes off its queue per pass (1 = one at a time).
+        // Bursts are drained in one go and instrumentation is paid per batch.
+        void set_drain_batch(size_t max_updates) {
+            drain_batch_.store(std::clamp<size_t>(max_updates, 1, kMaxDrainBatch), std::memory_order_relaxed);
         }
 
+        RoutingMode routing_mode() const { return routing_mode_; }
+        size_t shard_count() const { return shards_.size(); }
+
+        // The book engine on its own: a decoded snapshot or change applied to
+        // a book, with no queue, sequencing or publishing. Used by the worker
+        // that owns the book; public so bench_book can measure it in isolation.
+        static void parse_orderbook_update(Orderbook& ob, const BookUpdate& update);
+        static void apply_incremental_update(Orderbook& ob, const BookUpdate& update);
+
+        // Readers never take a lock the workers use, and never allocate:
+        // get_top_of_book() is a seqlock read, get_depth()/read_depth() read the
+        // latest immutable DepthSnapshot. All return false for unknown symbols.
+        bool get_top_of_book(const std::string& symbol, TopOfBook& out);
+        bool get_depth(const std::string& symbol, DepthSnapshot& out);
+
+        // Zero-copy variant: fn(const DepthSnapshot&) runs against the published
+        // snapshot. Keep fn short; it delays recycling of that snapshot.
+        template<typename Fn>
+        bool read_depth(const std::string& symbol, Fn&& fn) {
+            BookSlot* slot = slot_for(instruments_.find(symbol));
+            return slot && slot->depth.read(std::forward<Fn>(fn));
+        }
+
+        // Full Orderbook rebuilt from the latest depth snapshot, so it holds at
+        // most DepthSnapshot::kMaxLevels levels per side.
         Orderbook get_orderbook(const std::string &symbol);
 
         // Get stats
+        uint64_t get_update_count() const {
+            return total_updates_.load(std::memory_order_relaxed);
+        }
+
         size_t get_dropped_message_count() const {
             return dropped_messages_.load(std::memory_order_relaxed);
         }
 
+        // Feed messages merged into a conflated update instead of being queued.
+        size_t get_conflated_message_count() const {
+            return conflated_messages_.load(std::memory_order_relaxed);
+        }
+
+        // Most feed messages ever merged into a single conflated update.
+        size_t get_max_conflation_depth() const {
+            return max_conflation_depth_.load(std::memory_order_relaxed);
+        }
+
+        BackpressureMode backpressure_mode() const { return backpressure_; }
+
+        size_t get_gap_count() const {
+            return gaps_detected_.load(std::memory_order_relaxed);
+        }
+
+        size_t get_resync_count() const {
+            return resyncs_completed_.load(std::memory_order_relaxed);
+        }
+
+        // Per-stage latency of book messages, merged across every thread.
+        const LatencyTracker& latency() const { return latency_; }
+
+        // Startup only, once nothing is in flight (the warm-up calls it when
+        // it is done). Counts start again from zero and the stage latencies
+        // from a baseline, so what was processed until now is not reported.
+        // The counters do go back to zero: call it before anything exports
+        // them (MetricsServer), or a scrape would read it as a counter reset.
+        void restart_stats();
+
+        // Keeps an instrument (a warm-up one) out of the per-instrument reports.
+        void exclude_from_reports(InstrumentId id) {
+            if (BookSlot* slot = slot_for(id)) {
+                slot->reported.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        // Feed thread only, with the wall-clock receive time of a decoded
+        // exchange message (not for replays or the warm-up feed, whose
+        // timestamps are synthetic).
+        void record_feed_timing(const BookUpdate& update, int64_t receive_wall_ns) {
+            if (BookSlot* slot = slot_for(update.instrument_id)) {
+                slot->feed_timing.record(update.timestamp, receive_wall_ns);
+            }
+        }
+
+        // Calls fn(name, const FeedTiming&) for every instrument that has had
+        // an exchange message. Lock-free; safe from any thread.
+        template<typename Fn>
+        void for_each_feed_timing(Fn&& fn) const {
+            size_t count = instruments_.size();
+            for (size_t id = 0; id < count; ++id) {
+                BookSlot* slot = slot_for(static_cast<InstrumentId>(id));
+                if (slot && slot->reported.load(std::memory_order_relaxed) && slot->feed_timing.messages() > 0) {
+                    fn(instruments_.name(static_cast<InstrumentId>(id)), slot->feed_timing);
+                }
+            }
+        }
+
+        // Instruments that have lost sequence, with how often; nothing if none has.
+        void print_gaps(std::ostream& out) const;
+
+        // Exchange-to-local delay and jitter of every instrument that has had a message.
+        void print_feed_latency(std::ostream& out) const;
+
+        // One entry per shard ring, or the shared queue; none in RoutingMode::Inline.
+        std::vector<QueueMetrics> queue_metrics() const;
+
         // Print latency statistics
         void print_latency_stats() const {
             uint64_t total = total_updates_.load(std::memory_order_relaxed);
-            uint64_t total_lat = total_latency_ns_.load(std::memory_order_relaxed);
+            uint64_t total_ticks = total_processing_ticks_.load(std::memory_order_relaxed);
 
             if (total == 0) {
                 std::cout << "No latency data collected yet." << std::endl;
@@ -91,38 +422,308 @@ namespace deribit {
                 return;
             }
 
-            uint64_t avg_ns = total_lat / total;
+            uint64_t avg_ns = static_cast<uint64_t>(TscClock::to_ns(static_cast<int64_t>(total_ticks / total)));
 
             std::cout << "\n" << std::string(60, '=') << std::endl;
             std::cout << "LATENCY STATISTICS" << std::endl;
             std::cout << std::string(60, '=') << std::endl;
+            uint64_t batches = total_batches_.load(std::memory_order_relaxed);
+
             std::cout << "Total updates processed: " << total << std::endl;
             std::cout << "Average processing time: " << format_latency(avg_ns) << std::endl;
+            if (batches > 0) {
+                std::cout << "Average batch size: " << std::fixed << std::setprecision(1)
+                          << static_cast<double>(total) / batches << std::defaultfloat << std::endl;
+            }
+            std::cout << "Dropped messages: " << get_dropped_message_count() << std::endl;
+            std::cout << "Conflated messages: " << get_conflated_message_count()
+                      << " (max depth: " << get_max_conflation_depth() << ")" << std::endl;
+            std::cout << "Sequence gaps: " << get_gap_count()
+                      << " (resynced: " << get_resync_count() << ")" << std::endl;
+            print_gaps(std::cout);
+            std::cout << std::string(60, '-') << std::endl;
+            latency_.print_summary(std::cout);
+            std::cout << std::string(60, '-') << std::endl;
+            print_feed_latency(std::cout);
             std::cout << std::string(60, '=') << std::endl << std::endl;
         }
 
     private:
+        // Net effect of the updates merged while the worker queue was full.
+        // The feed thread merges into it and the worker takes it, both under
+        // `mutex`; `active` is the lock-free check the feed thread does first.
+        // The net level maps draw their nodes from `pool`, also under `mutex`.
+        struct Conflation {
+            Conflation() : bids(&pool), asks(&pool) {}
+
+            std::mutex mutex;
+            std::pmr::unsynchronized_pool_resource pool;
+            std::atomic<bool> active{false};
+            bool marker_queued = false;
+            std::atomic<size_t>* unmarked = nullptr;    // counted here until the marker is queued
+            uint32_t generation = 0;
+            size_t depth = 0;                   // feed messages merged so far
+
+            BookUpdateType type = BookUpdateType::Change;
+            int64_t timestamp = 0;
+            int64_t change_id = 0;
+            int64_t prev_change_id = 0;         // of the first merged change
+            uint64_t trace_id = 0;              // of the first merged message
+            int64_t receive_ticks = 0;          // of the first merged message, so latency
+            int64_t enqueue_ticks = 0;          // covers the whole time it was held back
+            std::pmr::map<double, BookLevel> bids;  // price -> net level
+            std::pmr::map<double, BookLevel> asks;
+        };
+
+        // The working book is private to whichever worker applies updates; readers
+        // only ever see what has been published. write_mutex serialises writers
+        // in RoutingMode::Shared and is never taken in the other modes.
+        //
+        // level_pool only ever serves the book's writer (one worker, or writers
+        // serialised by write_mutex), so it needs no locking of its own. It
+        // keeps freed nodes for reuse and never hands memory back while the
+        // book lives, so a book that has seen its working set stops allocating.
+        struct BookSlot {
+            InstrumentId id = kInvalidInstrument;
+            std::pmr::unsynchronized_pool_resource level_pool;
+            Orderbook book{&level_pool};
+            std::mutex write_mutex;
+            std::atomic<uint32_t> shard{0};
+            std::atomic<bool> reported{true};   // false for synthetic (warm-up) instruments
+            std::atomic<size_t> gaps{0};        // sequence gaps detected on this book
+            FeedTiming feed_timing;             // written by the feed thread
+            SeqLock<TopOfBook> top;
+            SnapshotPublisher<DepthSnapshot> depth;
+
+            // Resync state, owned by whichever worker writes the book.
+            std::vector<BookUpdate> pending_deltas;
+            std::chrono::steady_clock::time_point resync_requested_at;
+
+            Conflation conflation;
+            BookUpdate conflated;               // worker-side scratch for the merged update
+        };
+
+        static constexpr size_t kMaxDrainBatch = 256;
+
+        // Deltas buffered while waiting for a resync snapshot; beyond this the
+        // oldest half is discarded and the next snapshot has to be newer.
+        static constexpr size_t kMaxPendingDeltas = 4096;
+        static constexpr std::chrono::seconds kResyncRetryAfter{5};
+
+        // Side channel for the rare messages that do not come from the feed
+        // thread (resync snapshots). Workers check `pending` once per loop.
+        struct Inbox {
+            std::mutex mutex;
+            std::vector<BookUpdate> items;
+            std::vector<std::function<void()>> calls;     // run on the worker (e.g. book allocation)
+            std::atomic<bool> pending{false};
+        };
+
+        struct Shard {
+            Shard(size_t shard_index, size_t capacity, const WaitConfig& wait_config)
+                : index(shard_index), queue(capacity), wait(wait_config) {}
+            size_t index;
+            Buffer<BookUpdate, QueueMode::Spsc> queue;
+            Inbox inbox;
+            WaitStrategy wait;
+            std::atomic<size_t> high_water{0};
+            std::atomic<size_t> unmarked_conflations{0};    // conflated updates with no marker queued
+        };
+
         void worker_loop() {
+            std::vector<BookUpdate> batch(kMaxDrainBatch);
+            size_t batch_levels = 0;
+            uint32_t idle_polls = 0;
             while (running_) {
-                auto task = queue_.pop();
-                if (task) {
-                    // Measure latency
-                    auto start = std::chrono::high_resolution_clock::now();
-                    this->on_orderbook_update(task->first, task->second);
-                    auto end = std::chrono::high_resolution_clock::now();
-
-                    // Track latency
-                    auto duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
-                    total_latency_ns_.fetch_add(duration_ns, std::memory_order_relaxed);
-                    total_updates_.fetch_add(1, std::memory_order_relaxed);
+                reserve_batch(batch, batch_levels);
+                drain_inbox(shared_inbox_);
+                size_t n = queue_.pop_bulk(batch.data(), drain_batch_.load(std::memory_order_relaxed));
+                if (n > 0) {
+                    note_depth(shared_high_water_, n + queue_.size());
+                    process_batch(batch, n);
+                    idle_polls = 0;
+                } else if (shared_unmarked_conflations_.load(std::memory_order_relaxed) > 0 &&
+                           flush_conflation(nullptr)) {
+                    idle_polls = 0;
+                } else {
+                    shared_wait_.idle(idle_polls, [this] {
+                        return !queue_.empty() || shared_inbox_.pending.load(std::memory_order_acquire) ||
+                               !running_;
+                    });
                 }
             }
         }
 
-        void on_orderbook_update(const std::string &symbol, const Json::Value &payload);
-        std::mutex& get_mutex_for_symbol(const std::string& symbol);
-        void parse_orderbook_update(const std::string& symbol, const Json::Value& json_data);
-        void apply_incremental_update(Orderbook& ob, const Json::Value& update_data);
+        void shard_loop(Shard& shard) {
+            std::vector<BookUpdate> batch(kMaxDrainBatch);
+            size_t batch_levels = 0;
+            uint32_t idle_polls = 0;
+            while (running_) {
+                reserve_batch(batch, batch_levels);
+                drain_inbox(shard.inbox);
+                size_t n = shard.queue.pop_bulk(batch.data(), drain_batch_.load(std::memory_order_relaxed));
+                if (n > 0) {
+                    note_depth(shard.high_water, n + shard.queue.size());
+                    process_batch(batch, n);
+                    idle_polls = 0;
+                } else if (shard.unmarked_conflations.load(std::memory_order_relaxed) > 0 &&
+                           flush_conflation(&shard)) {
+                    idle_polls = 0;
+                } else {
+                    shard.wait.idle(idle_polls, [this, &shard] {
+                        return !shard.queue.empty() || shard.inbox.pending.load(std::memory_order_acquire) ||
+                               !running_;
+                    });
+                }
+            }
+        }
+
+        // Popping swaps the batch's level vectors into the ring, so the batch
+        // is reserved like the ring slots, on the worker's next pass after
+        // prepare_memory().
+        void reserve_batch(std::vector<BookUpdate>& batch, size_t& reserved) const {
+            size_t levels = reserve_levels_.load(std::memory_order_relaxed);
+            if (levels == reserved) {
+                return;
+            }
+            for (BookUpdate& update : batch) {
+                update.bids.reserve(levels);
+                update.asks.reserve(levels);
+            }
+            reserved = levels;
+        }
+
+        // Once per drained batch: what was popped plus what is still queued.
+        static void note_depth(std::atomic<size_t>& high_water, size_t depth) {
+            size_t seen = high_water.load(std::memory_order_relaxed);
+            while (depth > seen && !high_water.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {
+            }
+        }
+
+        void drain_inbox(Inbox& inbox) {
+            if (!inbox.pending.load(std::memory_order_acquire)) {
+                return;
+            }
+            std::vector<BookUpdate> items;
+            std::vector<std::function<void()>> calls;
+            {
+                std::lock_guard<std::mutex> lock(inbox.mutex);
+                items.swap(inbox.items);
+                calls.swap(inbox.calls);
+                inbox.pending.store(false, std::memory_order_relaxed);
+            }
+            for (auto& call : calls) {
+                call();
+            }
+            for (const BookUpdate& item : items) {
+                on_orderbook_update(item);
+            }
+        }
+
+        // Applies batch[0..n) with one dequeue timestamp and one pair of
+        // counter updates for the whole batch; stages are recorded per message.
+        void process_batch(std::vector<BookUpdate>& batch, size_t n) {
+            int64_t start = TscClock::now();
+
+            if (n == 1) {
+                apply_dequeued(batch[0], start);
+            } else {
+                // Group the batch by instrument so each book is applied back to
+                // back while it is hot. Insertion sort is stable (per-instrument
+                // order is kept) and does not allocate; n is small.
+                std::array<uint16_t, kMaxDrainBatch> order;
+                for (size_t i = 0; i < n; ++i) {
+                    uint16_t idx = static_cast<uint16_t>(i);
+                    size_t j = i;
+                    while (j > 0 && batch[order[j - 1]].instrument_id > batch[idx].instrument_id) {
+                        order[j] = order[j - 1];
+                        --j;
+                    }
+                    order[j] = idx;
+                }
+                for (size_t i = 0; i < n; ++i) {
+                    apply_dequeued(batch[order[i]], start);
+                }
+            }
+
+            record_processing(start, n);
+        }
+
+        void apply_dequeued(const BookUpdate& update, int64_t dequeued) {
+            StageRecorder* stages = current_stages_;
+            stages->current = StageStamps{update.receive_ticks, update.enqueue_ticks, dequeued, 0, 0};
+            EventTracer::record(TraceEvent::Dequeued, update.trace_id, update.instrument_id);
+            on_orderbook_update(update);
+            EventTracer::record(TraceEvent::Applied, update.trace_id, update.instrument_id);
+            finish_stages(*stages);
+        }
+
+        // Records the message's stages; a slow one may trigger a trace dump.
+        static void finish_stages(StageRecorder& stages) {
+            stages.record(stages.current);
+            const StageStamps& s = stages.current;
+            if (s.receive_ticks && s.callback_end_ticks) {
+                EventTracer::check(s.callback_end_ticks - s.receive_ticks);
+            }
+        }
+
+        void record_processing(int64_t start, size_t n) {
+            total_processing_ticks_.fetch_add(static_cast<uint64_t>(TscClock::now() - start), std::memory_order_relaxed);
+            total_updates_.fetch_add(n, std::memory_order_relaxed);
+            total_batches_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        BookSlot* slot_for(InstrumentId id) const {
+            return id < books_.size() ? books_[id].load(std::memory_order_acquire) : nullptr;
+        }
+
+        bool push_to_worker(BookSlot& slot, const BookUpdate& update) {
+            if (routing_mode_ == RoutingMode::Sharded) {
+                Shard& shard = *shards_[slot.shard.load(std::memory_order_relaxed)];
+                if (!shard.queue.push(update)) {
+                    return false;
+                }
+                shard.wait.notify();
+                return true;
+            }
+            if (!queue_.push(update)) {
+                return false;
+            }
+            shared_wait_.notify();
+            return true;
+        }
+
+        // Conflation: feed-thread side
+        bool conflate(BookSlot& slot, const BookUpdate& update);
+        void merge_conflated(Conflation& c, const BookUpdate& update);
+        void begin_conflation(BookSlot& slot, const BookUpdate& update);
+        bool queue_conflation_marker(BookSlot& slot);
+        void retry_conflation_markers();
+        // Conflation: worker side
+        bool take_conflated(BookSlot& slot, const uint32_t* generation);
+        bool flush_conflation(Shard* shard);
+        static void clear_unmarked(Conflation& c);
+
+        // Where an idle worker looks to see whether it has anything to flush.
+        std::atomic<size_t>& unmarked_conflations(const BookSlot& slot) {
+            if (routing_mode_ == RoutingMode::Sharded) {
+                return shards_[slot.shard.load(std::memory_order_relaxed)]->unmarked_conflations;
+            }
+            return shared_unmarked_conflations_;
+        }
+
+        BookSlot* create_slot(size_t shard);
+        BookSlot* new_slot() const;
+        void post_to_shard(Shard& shard, std::function<void()> call);
+
+        void on_orderbook_update(const BookUpdate& update);
+        void apply_update(BookSlot& slot, const BookUpdate& update);
+        void start_resync(BookSlot& slot, const BookUpdate& update);
+        void buffer_delta(BookSlot& slot, const BookUpdate& update);
+        void replay_pending(BookSlot& slot);
+        void request_resync(BookSlot& slot);
+        void publish(BookSlot& slot);
+        static void refresh_best_levels(Orderbook& ob);
 
         // Format latency for display
         std::string format_latency(uint64_t ns) const {
@@ -135,19 +736,48 @@ namespace deribit {
             }
         }
 
-        std::mutex orderbooks_mutex_;
-        std::map<std::string, Orderbook> orderbooks_;
-        std::unordered_map<std::string, std::unique_ptr<std::mutex>> orderbook_mutexes_;
-        std::mutex mutexes_map_mutex_;
+        RoutingMode routing_mode_;
+        BackpressureMode backpressure_;
+
+        // Indexed by InstrumentId. Slots are created once by register_instrument()
+        // and never move, so the hot path is a single array load.
+        InstrumentRegistry instruments_;
+        std::vector<std::atomic<BookSlot*>> books_;
+        std::mutex register_mutex_;
+
+        Buffer<BookUpdate, QueueMode::Spmc> queue_; // RoutingMode::Shared
+        Inbox shared_inbox_;                        // RoutingMode::Shared
+        WaitStrategy shared_wait_;                  // RoutingMode::Shared
+        std::atomic<size_t> shared_high_water_{0};  // RoutingMode::Shared
+        std::atomic<size_t> shared_unmarked_conflations_{0};    // RoutingMode::Shared
+        std::vector<std::unique_ptr<Shard>> shards_; // RoutingMode::Sharded
 
-        Buffer<std::pair<std::string, Json::Value>> queue_;
         std::vector<std::thread> workers_;
         std::atomic<bool> running_;
         std::atomic<size_t> dropped_messages_;  // Track dropped messages
+        std::atomic<size_t> conflated_messages_{0};
+        std::atomic<size_t> max_conflation_depth_{0};
+        std::vector<BookSlot*> pending_markers_;    // feed thread only: markers that did not fit
+        std::atomic<size_t> gaps_detected_{0};
+        std::atomic<size_t> resyncs_completed_{0};
+
+        std::mutex resync_mutex_;
+        ResyncHandler resync_handler_;
+        OrderBookUpdateCallback update_callback_;
 
         // Simple latency tracking
         std::atomic<uint64_t> total_updates_;
-        std::atomic<uint64_t> total_latency_ns_;
+        std::atomic<uint64_t> total_processing_ticks_;     // TscClock ticks
+        std::atomic<uint64_t> total_batches_{0};
+        std::atomic<size_t> drain_batch_{64};
+        std::atomic<size_t> reserve_levels_{0};     // set by prepare_memory()
+
+        // Stage breakdown. Each worker records into its own recorder (the
+        // feed thread into inline_stages_ in RoutingMode::Inline), reached on
+        // the hot path through current_stages_, which is null on other threads.
+        LatencyTracker latency_;
+        StageRecorder* inline_stages_;
+        static inline thread_local StageRecorder* current_stages_ = nullptr;
     };
 
 }
@@ -142,13 +142,17 @@ public:
         bool can_buy = position_.size < config_.max_position;
         bool can_sell = position_.size > -config_.max_position;
 
+        // Orders carry the feed message they react to, for tick-to-trade timing
+        TraceContext trace = ob.trace;
+        trace.decision_ticks = TscClock::now();
+
         // Simple strategy: Place limit orders if we don't have active orders
         if (active_buy_order_.empty() && can_buy) {
-            place_buy_order(our_bid);
+            place_buy_order(our_bid, trace);
         }
 
         if (active_sell_order_.empty() && can_sell) {
-            place_sell_order(our_ask);
+            place_sell_order(our_ask, trace);
         }
     }
 
@@ -180,13 +184,14 @@ public:
     }
 
 private:
-    void place_buy_order(double price) {
+    void place_buy_order(double price, const TraceContext& trace) {
         OrderParams params;
         params.instrument_name = config_.instrument;
         params.amount = config_.order_size;
         params.price = price;
         params.type = "limit";
         params.side = "buy";
+        params.trace = trace;
 
         params.callback = [this](const std::string& order_id, bool success) {
             if (success) {
@@ -201,13 +206,14 @@ private:
         order_manager_.submit_order_async(std::move(params));
     }
 
-    void place_sell_order(double price) {
+    void place_sell_order(double price, const TraceContext& trace) {
         OrderParams params;
         params.instrument_name = config_.instrument;
         params.amount = config_.order_size;
         params.price = price;
         params.type = "limit";
         params.side = "sell";
+        params.trace = trace;
 
         params.callback = [this](const std::string& order_id, bool success) {
             if (success) {
@@ -0,0 +1,89 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef MEMORY_PREFAULT_H
+#define MEMORY_PREFAULT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace deribit {
+
+    inline size_t page_size() {
+#if defined(__linux__)
+        static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+#else
+        return 4096;
+#endif
+    }
+
+    // The 2 MiB-aligned part of [data, data + bytes); false if there is none.
+    inline bool huge_page_interior(void* data, size_t bytes, void*& start, size_t& length) {
+        constexpr uintptr_t kHuge = 2 * 1024 * 1024;
+        uintptr_t lo = (reinterpret_cast<uintptr_t>(data) + kHuge - 1) & ~(kHuge - 1);
+        uintptr_t hi = (reinterpret_cast<uintptr_t>(data) + bytes) & ~(kHuge - 1);
+        if (hi <= lo) {
+            return false;
+        }
+        start = reinterpret_cast<void*>(lo);
+        length = hi - lo;
+        return true;
+    }
+
+    // Asks for transparent huge pages on the 2 MiB-aligned interior of the
+    // range and, where the kernel supports MADV_COLLAPSE (6.1+), collapses
+    // pages that are already faulted in right away instead of waiting for
+    // khugepaged. Best effort: errors are ignored.
+    inline void advise_huge_pages(void* data, size_t bytes) {
+        void* start = nullptr;
+        size_t length = 0;
+        if (!huge_page_interior(data, bytes, start, length)) {
+            return;
+        }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        madvise(start, length, MADV_HUGEPAGE);
+#endif
+#if defined(__linux__) && defined(MADV_COLLAPSE)
+        madvise(start, length, MADV_COLLAPSE);
+#endif
+    }
+
+    // Faults in every page of [data, data + bytes) by rewriting one byte per
+    // page with its own value, so the first real write does not take a page
+    // fault (or a copy-on-write of the zero page). Only call this on memory
+    // no other thread is using.
+    inline void prefault(void* data, size_t bytes, bool huge_pages) {
+        if (!data || bytes == 0) {
+            return;
+        }
+        const size_t step = page_size();
+        auto* begin = static_cast<unsigned char*>(data);
+        for (size_t offset = 0; offset < bytes; offset += step) {
+            volatile unsigned char* p = begin + offset;
+            *p = *p;
+        }
+        if (huge_pages) {
+            advise_huge_pages(data, bytes);
+        }
+    }
+
+    // Locks everything mapped now and everything mapped later into RAM, so
+    // nothing on the tick path is ever paged out. Usually needs CAP_IPC_LOCK
+    // or a raised RLIMIT_MEMLOCK; returns false if the kernel refused.
+    inline bool lock_all_memory() {
+#if defined(__linux__)
+        return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#else
+        return false;
+#endif
+    }
+}
+
+#endif //MEMORY_PREFAULT_H
@@ -0,0 +1,52 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include "market_data.hpp"
+#include "order.hpp"
+#include <cpprest/http_listener.h>
+#include <memory>
+#include <string>
+
+namespace deribit {
+
+    // Serves GET /metrics on 127.0.0.1:<port> in the Prometheus text format:
+    // pipeline counters, worker queue depth and high-water mark, per-stage
+    // latency, per-instrument feed message counts, delay and jitter, order
+    // round trips and tick-to-trade segments. Latencies are summaries
+    // (quantiles, _sum, _count) in seconds, computed from the same histograms
+    // as menu option 7.
+    //
+    // A scrape only reads atomics and copies histograms on the listener's
+    // own thread; it never takes a lock the feed or the workers take, so it
+    // cannot stall them.
+    class MetricsServer {
+    public:
+        MetricsServer(int port, const MarketData& market_data, const OrderManager* orders = nullptr)
+            : port_(port), market_data_(market_data), orders_(orders) {}
+        ~MetricsServer();
+
+        MetricsServer(const MetricsServer&) = delete;
+        MetricsServer& operator=(const MetricsServer&) = delete;
+
+        // False (with a message) if the port could not be opened.
+        bool start();
+        void stop();
+
+        std::string url() const { return "http://127.0.0.1:" + std::to_string(port_) + "/metrics"; }
+
+        // The exposition text a scrape returns.
+        std::string render() const;
+
+    private:
+        int port_;
+        const MarketData& market_data_;
+        const OrderManager* orders_;
+        std::unique_ptr<web::http::experimental::listener::http_listener> listener_;
+    };
+}
+
+#endif //METRICS_SERVER_H
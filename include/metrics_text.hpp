@@ -0,0 +1,74 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef METRICS_TEXT_H
+#define METRICS_TEXT_H
+
+#include "latency_histogram.hpp"
+#include "market_data.hpp"
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace deribit {
+
+    // Prometheus text exposition, without the HTTP side, so that anything
+    // linking MarketData can render (and a bench can print) what MetricsServer
+    // serves.
+    namespace metrics_text {
+
+        constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999, 0.9999};
+
+        inline void header(std::ostream& out, const char* name, const char* type, const char* help) {
+            out << "# HELP " << name << ' ' << help << '\n';
+            out << "# TYPE " << name << ' ' << type << '\n';
+        }
+
+        template<typename T>
+        void sample(std::ostream& out, const char* name, const std::string& labels, T value) {
+            out << name;
+            if (!labels.empty()) {
+                out << '{' << labels << '}';
+            }
+            out << ' ' << value << '\n';
+        }
+
+        // Label values here are instrument names and fixed words, but quote
+        // them properly anyway.
+        inline std::string label(const char* key, const std::string& value) {
+            std::string out = std::string(key) + "=\"";
+            for (char c : value) {
+                if (c == '\\' || c == '"') {
+                    out += '\\';
+                } else if (c == '\n') {
+                    out += "\\n";
+                    continue;
+                }
+                out += c;
+            }
+            return out + '"';
+        }
+
+        // `seconds_per_unit` converts the histogram's unit (ns or TscClock ticks).
+        inline void summary(std::ostream& out, const char* name, const std::string& labels,
+                            const HistogramSnapshot& h, double seconds_per_unit) {
+            std::string prefix = labels.empty() ? "" : labels + ",";
+            for (double q : kQuantiles) {
+                std::ostringstream quantile;
+                quantile << "quantile=\"" << q << '"';
+                sample(out, name, prefix + quantile.str(),
+                       static_cast<double>(h.percentile(q * 100.0)) * seconds_per_unit);
+            }
+            std::string base(name);
+            sample(out, (base + "_sum").c_str(), labels, static_cast<double>(h.sum()) * seconds_per_unit);
+            sample(out, (base + "_count").c_str(), labels, h.count());
+        }
+
+        // Pipeline counters, worker queues, stage latency and per-instrument
+        // feed timing. `out` should carry precision(9).
+        void render_market_data(std::ostream& out, const MarketData& market_data);
+    }
+}
+
+#endif //METRICS_TEXT_H
@@ -6,6 +6,10 @@
 #define ORDER_H
 #include "config.hpp"
 #include "buffer.hpp"
+#include "wait_strategy.hpp"
+#include "latency_histogram.hpp"
+#include "order_params.hpp"
+#include "tick_to_trade.hpp"
 #include <string>
 #include <cpprest/http_client.h>
 #include <thread>
@@ -16,24 +20,12 @@
 
 namespace deribit {
 
-struct OrderParams {
-    std::string instrument_name;
-    double amount;
-    double price;
-    std::string type;
-    std::string side;
-
-    std::function<void(const std::string& order_id, bool success)> callback;
-
-    OrderParams() = default;
-
-    OrderParams(const std::string& instrument, double amt, double pr, const std::string& order_type)
-        : instrument_name(instrument), amount(amt), price(pr), type(order_type) {}
-};
-
 class OrderManager {
 public:
-    explicit OrderManager(Config& config, size_t thread_pool_size = 4, size_t buffer_capacity = 1024);
+    // `wait` is what an idle order worker does; it bounds how quickly a
+    // submitted order is picked up.
+    explicit OrderManager(Config& config, size_t thread_pool_size = 4, size_t buffer_capacity = 1024,
+                          const WaitConfig& wait = WaitConfig{});
     ~OrderManager();
 
     std::string place_buy_order(const OrderParams& params);
@@ -53,21 +45,38 @@ public:
     size_t pending_orders() const;
     bool is_async_running() const;
 
+    // Round trip of every REST request (send -> response), in TscClock ticks,
+    // including ones that failed. Safe to read from any thread.
+    const LatencyHistogram& round_trip() const { return round_trip_; }
+    uint64_t request_errors() const { return request_errors_.load(std::memory_order_relaxed); }
+
+    // Feed-to-ack latency of async orders that carry a trace (strategy
+    // orders), per segment. Safe to read from any thread.
+    const TickToTrade& tick_to_trade() const { return tick_to_trade_; }
+
 private:
     Config& config_;
     web::http::client::http_client client_;
 
-    std::unique_ptr<Buffer<OrderParams>> order_buffer_;
+    std::unique_ptr<Buffer<OrderParams, QueueMode::Mpmc>> order_buffer_;   // any thread submits, the pool consumes
+    WaitStrategy order_wait_;
     std::vector<std::thread> workers_;
     std::atomic<bool> running_;
     bool async_enabled_;
+    LatencyHistogram round_trip_;
+    std::atomic<uint64_t> request_errors_{0};
+    TickToTrade tick_to_trade_;
 
     web::http::http_request create_authenticated_request(
         web::http::method method,
         const std::string& path
     );
 
-    void worker_thread();
+    // Sends and waits for the response, timing the round trip. Throws what
+    // the client throws (after counting it).
+    web::http::http_response send(const web::http::http_request& request);
+
+    void worker_thread(size_t index);
     void process_order(const OrderParams& params);
 
     std::string place_buy_order_internal(const OrderParams& params);
@@ -0,0 +1,32 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef ORDER_PARAMS_H
+#define ORDER_PARAMS_H
+
+#include <functional>
+#include <string>
+
+#include "tick_to_trade.hpp"
+
+namespace deribit {
+
+struct OrderParams {
+    std::string instrument_name;
+    double amount;
+    double price;
+    std::string type;
+    std::string side;
+    TraceContext trace;     // set by a strategy reacting to the feed; times the order end to end
+
+    std::function<void(const std::string& order_id, bool success)> callback;
+
+    OrderParams() = default;
+
+    OrderParams(const std::string& instrument, double amt, double pr, const std::string& order_type)
+        : instrument_name(instrument), amount(amt), price(pr), type(order_type) {}
+};
+
+} // namespace deribit
+#endif //ORDER_PARAMS_H
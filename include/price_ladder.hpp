@@ -0,0 +1,360 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef PRICE_LADDER_H
+#define PRICE_LADDER_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+#include "scratch_arena.hpp"
+
+namespace deribit {
+
+    enum class BookSide { Bid, Ask };
+
+    // Tick-indexed price ladder for one side of a book.
+    //
+    // Levels near the touch live in a contiguous ring of `window` ticks, indexed
+    // directly by tick number, so an update is an array store instead of a tree
+    // insert. Prices outside the window (or off the tick grid) fall back to an
+    // ordered overflow map. The window is re-anchored when the touch walks out
+    // of it, leaving some headroom on the spread side so the best level can
+    // move towards the mid without immediately forcing another re-anchor.
+    //
+    // Overflow nodes come from `levels`, normally a pool owned by the book, so
+    // a far level appearing and disappearing recycles a node instead of going
+    // to the global heap. A copied ladder uses the default resource.
+    template<BookSide Side>
+    class PriceLadder {
+    public:
+        static constexpr double kDefaultTickSize = 0.5;
+        static constexpr size_t kDefaultWindow = 2048;
+
+        explicit PriceLadder(double tick_size = kDefaultTickSize, size_t window = kDefaultWindow,
+                             std::pmr::memory_resource* levels = std::pmr::get_default_resource())
+            : amounts_(round_up_pow2(window), 0.0), mask_(amounts_.size() - 1), overflow_(levels) {
+            set_tick_grid(tick_size);
+        }
+
+        // Changing the tick size invalidates every stored index, so the ladder is cleared.
+        void set_tick_size(double tick_size) {
+            clear();
+            set_tick_grid(tick_size);
+        }
+
+        double tick_size() const { return tick_size_; }
+
+        void clear() {
+            std::fill(amounts_.begin(), amounts_.end(), 0.0);
+            overflow_.clear();
+            window_count_ = 0;
+            anchored_ = false;
+        }
+
+        bool empty() const { return window_count_ == 0 && overflow_.empty(); }
+        size_t size() const { return window_count_ + overflow_.size(); }
+
+        void set(double price, double amount) {
+            if (amount == 0.0) {
+                erase(price);
+                return;
+            }
+
+            int64_t idx;
+            if (!to_index(price, idx)) {
+                overflow_[price] = amount;
+                return;
+            }
+
+            if (!in_window(idx)) {
+                // The touch has moved past the window (or nothing is anchored yet):
+                // re-anchor around it. Levels behind the touch just overflow.
+                if (!anchored_ || window_count_ == 0 || better(idx, best_idx_)) {
+                    recenter(idx);
+                } else {
+                    overflow_[price] = amount;
+                    return;
+                }
+            }
+
+            double& slot = amounts_[slot_of(idx)];
+            if (slot == 0.0) {
+                ++window_count_;
+                if (window_count_ == 1 || better(idx, best_idx_)) {
+                    best_idx_ = idx;
+                }
+            }
+            slot = amount;
+        }
+
+        void erase(double price) {
+            int64_t idx;
+            if (!to_index(price, idx) || !in_window(idx)) {
+                overflow_.erase(price);
+                return;
+            }
+
+            double& slot = amounts_[slot_of(idx)];
+            if (slot == 0.0) {
+                return;
+            }
+            slot = 0.0;
+            --window_count_;
+
+            if (window_count_ > 0 && idx == best_idx_) {
+                // Walk away from the touch to the next populated tick.
+                int64_t i = idx;
+                do {
+                    i = worse_step(i);
+                } while (amounts_[slot_of(i)] == 0.0);
+                best_idx_ = i;
+            }
+        }
+
+        // Amount resting at `price`, or 0 if the level is empty.
+        double amount_at(double price) const {
+            int64_t idx;
+            if (to_index(price, idx) && in_window(idx)) {
+                return amounts_[slot_of(idx)];
+            }
+            auto it = overflow_.find(price);
+            return it != overflow_.end() ? it->second : 0.0;
+        }
+
+        double best_price() const {
+            return best_level().first;
+        }
+
+        double best_amount() const {
+            return best_level().second;
+        }
+
+        std::pair<double, double> best_level() const {
+            bool has_window = window_count_ > 0;
+            bool has_overflow = !overflow_.empty();
+
+            if (!has_window && !has_overflow) {
+                return {0.0, 0.0};
+            }
+
+            std::pair<double, double> window_best;
+            if (has_window) {
+                window_best = {price_of(best_idx_), amounts_[slot_of(best_idx_)]};
+                if (!has_overflow) return window_best;
+            }
+
+            std::pair<double, double> overflow_best = (Side == BookSide::Bid)
+                ? std::pair<double, double>(*overflow_.rbegin())
+                : std::pair<double, double>(*overflow_.begin());
+            if (!has_window) return overflow_best;
+
+            return better_price(overflow_best.first, window_best.first) ? overflow_best : window_best;
+        }
+
+        // Visits up to `max_levels` levels from the touch outwards as fn(price, amount).
+        // Returns the number of levels visited.
+        template<typename Fn>
+        size_t for_each_level(size_t max_levels, Fn&& fn) const {
+            size_t visited = 0;
+
+            int64_t idx = best_idx_;
+            size_t window_left = window_count_;
+
+            auto ov = overflow_begin();
+            auto ov_end = overflow_end();
+
+            while (visited < max_levels && (window_left > 0 || ov != ov_end)) {
+                if (window_left > 0) {
+                    while (amounts_[slot_of(idx)] == 0.0) {
+                        idx = worse_step(idx);
+                    }
+                }
+
+                bool take_window = window_left > 0 &&
+                    (ov == ov_end || !better_price(ov->first, price_of(idx)));
+
+                if (take_window) {
+                    fn(price_of(idx), amounts_[slot_of(idx)]);
+                    --window_left;
+                    if (window_left > 0) idx = worse_step(idx);
+                } else {
+                    fn(ov->first, ov->second);
+                    ++ov;
+                }
+                ++visited;
+            }
+            return visited;
+        }
+
+        std::vector<std::pair<double, double>> top(size_t n) const {
+            std::vector<std::pair<double, double>> levels;
+            levels.reserve(std::min(n, size()));
+            for_each_level(n, [&levels](double price, double amount) {
+                levels.emplace_back(price, amount);
+            });
+            return levels;
+        }
+
+        // Smallest gap between consecutive prices, snapped to a decimal tick.
+        // Used to pick a grid for instruments whose tick size we were not told.
+        // Sorts [first, last) in place.
+        template<typename It>
+        static double infer_tick_size(It first, It last, double fallback = kDefaultTickSize) {
+            if (last - first < 2) return fallback;
+            std::sort(first, last);
+
+            double min_gap = 0.0;
+            for (It it = first + 1; it != last; ++it) {
+                double gap = *it - *(it - 1);
+                if (gap > 0.0 && (min_gap == 0.0 || gap < min_gap)) {
+                    min_gap = gap;
+                }
+            }
+            if (min_gap <= 0.0) return fallback;
+
+            double scale = 1.0;
+            for (int k = 0; k < 9 && std::abs(min_gap * scale - std::round(min_gap * scale)) > 1e-6; ++k) {
+                scale *= 10.0;
+            }
+            double snapped = std::round(min_gap * scale) / scale;
+            return snapped > 0.0 ? snapped : fallback;
+        }
+
+    private:
+        using OverflowMap = std::pmr::map<double, double>;
+        using OverflowIter = typename std::conditional<Side == BookSide::Bid,
+            OverflowMap::const_reverse_iterator, OverflowMap::const_iterator>::type;
+
+        static size_t round_up_pow2(size_t n) {
+            size_t p = 64;
+            while (p < n) p <<= 1;
+            return p;
+        }
+
+        // Store the tick as num / den with den a power of ten so that converting
+        // an index back to a price is one integer product and one correctly
+        // rounded division, giving back exactly the double the feed sent.
+        void set_tick_grid(double tick_size) {
+            tick_size_ = tick_size > 0.0 ? tick_size : kDefaultTickSize;
+            tick_den_ = 1.0;
+            for (int k = 0; k < 9 && std::abs(tick_size_ * tick_den_ - std::round(tick_size_ * tick_den_)) > 1e-9; ++k) {
+                tick_den_ *= 10.0;
+            }
+            tick_num_ = std::round(tick_size_ * tick_den_);
+        }
+
+        bool to_index(double price, int64_t& idx) const {
+            double ticks = price * tick_den_ / tick_num_;
+            double rounded = std::round(ticks);
+            if (std::abs(ticks - rounded) > 1e-6) {
+                return false;
+            }
+            idx = static_cast<int64_t>(rounded);
+            return true;
+        }
+
+        double price_of(int64_t idx) const {
+            return static_cast<double>(idx) * tick_num_ / tick_den_;
+        }
+
+        size_t slot_of(int64_t idx) const {
+            return static_cast<size_t>(static_cast<uint64_t>(idx) & mask_);
+        }
+
+        bool in_window(int64_t idx) const {
+            return anchored_ && idx >= lo_ && idx < lo_ + static_cast<int64_t>(amounts_.size());
+        }
+
+        static bool better(int64_t a, int64_t b) {
+            return Side == BookSide::Bid ? a > b : a < b;
+        }
+
+        static bool better_price(double a, double b) {
+            return Side == BookSide::Bid ? a > b : a < b;
+        }
+
+        static int64_t worse_step(int64_t idx) {
+            return Side == BookSide::Bid ? idx - 1 : idx + 1;
+        }
+
+        OverflowIter overflow_begin() const {
+            if constexpr (Side == BookSide::Bid) return overflow_.rbegin();
+            else return overflow_.begin();
+        }
+
+        OverflowIter overflow_end() const {
+            if constexpr (Side == BookSide::Bid) return overflow_.rend();
+            else return overflow_.end();
+        }
+
+        // Re-anchor the window so `touch_idx` sits a quarter of the window in
+        // from the spread-side edge, then migrate every on-grid level into
+        // whichever store now owns it.
+        void recenter(int64_t touch_idx) {
+            const int64_t n = static_cast<int64_t>(amounts_.size());
+
+            ScratchArena::Scope scratch;
+            std::pmr::vector<std::pair<int64_t, double>> levels(scratch.resource());
+            levels.reserve(window_count_);
+            if (anchored_) {
+                for (int64_t i = lo_; i < lo_ + n && levels.size() < window_count_; ++i) {
+                    double amount = amounts_[slot_of(i)];
+                    if (amount != 0.0) levels.emplace_back(i, amount);
+                }
+            }
+            std::fill(amounts_.begin(), amounts_.end(), 0.0);
+            window_count_ = 0;
+
+            lo_ = (Side == BookSide::Bid) ? touch_idx - (n - n / 4) : touch_idx - n / 4;
+            anchored_ = true;
+
+            for (auto it = overflow_.begin(); it != overflow_.end();) {
+                int64_t idx;
+                if (to_index(it->first, idx) && in_window(idx)) {
+                    levels.emplace_back(idx, it->second);
+                    it = overflow_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+
+            for (const auto& [idx, amount] : levels) {
+                if (in_window(idx)) {
+                    amounts_[slot_of(idx)] = amount;
+                    if (window_count_++ == 0 || better(idx, best_idx_)) {
+                        best_idx_ = idx;
+                    }
+                } else {
+                    overflow_[price_of(idx)] = amount;
+                }
+            }
+        }
+
+        std::vector<double> amounts_;
+        size_t mask_;
+        int64_t lo_ = 0;
+        int64_t best_idx_ = 0;
+        size_t window_count_ = 0;
+        bool anchored_ = false;
+
+        double tick_size_ = kDefaultTickSize;
+        double tick_num_ = 5.0;
+        double tick_den_ = 10.0;
+
+        OverflowMap overflow_;
+    };
+
+    using BidLadder = PriceLadder<BookSide::Bid>;
+    using AskLadder = PriceLadder<BookSide::Ask>;
+}
+
+#endif //PRICE_LADDER_H
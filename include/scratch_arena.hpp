@@ -0,0 +1,71 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+#include "memory_prefault.hpp"
+
+namespace deribit {
+
+    // Per-thread bump allocator for scratch that only lives while one message
+    // is handled (tick inference on a snapshot, levels migrated by a ladder
+    // re-anchor, ...). Allocating is a pointer bump inside a buffer the thread
+    // owns; nothing is freed one by one, the arena is rewound when the
+    // outermost Scope on the thread ends. Only a message that needs more than
+    // kBytes of scratch reaches the heap, and that memory is returned on rewind.
+    class ScratchArena {
+    public:
+        static constexpr size_t kBytes = 64 * 1024;
+
+        static ScratchArena& local() {
+            thread_local ScratchArena arena;
+            return arena;
+        }
+
+        std::pmr::memory_resource* resource() { return &resource_; }
+
+        // Faults the buffer in ahead of the first message; call on the owning thread.
+        void prefault() { deribit::prefault(buffer_.get(), kBytes, false); }
+
+        // Bounds the scratch of one message. Scopes nest, and only the
+        // outermost rewinds, so a callee can open its own without knowing
+        // whether the caller already did.
+        class Scope {
+        public:
+            Scope() : arena_(local()) { ++arena_.depth_; }
+            ~Scope() {
+                if (--arena_.depth_ == 0) {
+                    arena_.resource_.release();
+                }
+            }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            std::pmr::memory_resource* resource() const { return arena_.resource(); }
+
+        private:
+            ScratchArena& arena_;
+        };
+
+        ScratchArena(const ScratchArena&) = delete;
+        ScratchArena& operator=(const ScratchArena&) = delete;
+
+    private:
+        // The buffer is allocated by the thread that first uses the arena, so
+        // it is first touched on that thread's NUMA node.
+        ScratchArena() : buffer_(new std::byte[kBytes]), resource_(buffer_.get(), kBytes) {}
+
+        std::unique_ptr<std::byte[]> buffer_;
+        std::pmr::monotonic_buffer_resource resource_;
+        size_t depth_ = 0;
+    };
+}
+
+#endif //SCRATCH_ARENA_H
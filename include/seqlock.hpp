@@ -0,0 +1,77 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace deribit {
+
+    // Single-writer sequence lock for small trivially copyable values.
+    //
+    // The writer never waits. Readers retry if the sequence was odd (write in
+    // progress) or changed while they copied. The payload is stored as relaxed
+    // atomic words so a torn read is merely discarded, never a data race.
+    template<typename T>
+    class SeqLock {
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+        static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    public:
+        SeqLock() : seq_(0) {
+            for (auto& w : words_) w.store(0, std::memory_order_relaxed);
+        }
+
+        void store(const T& value) {
+            uint64_t buf[kWords] = {};
+            std::memcpy(buf, &value, sizeof(T));
+
+            uint64_t seq = seq_.load(std::memory_order_relaxed);
+            seq_.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for (size_t i = 0; i < kWords; ++i) {
+                words_[i].store(buf[i], std::memory_order_relaxed);
+            }
+
+            seq_.store(seq + 2, std::memory_order_release);
+        }
+
+        T load() const {
+            uint64_t buf[kWords];
+            while (true) {
+                uint64_t before = seq_.load(std::memory_order_acquire);
+                if (before & 1) {
+                    continue;
+                }
+                for (size_t i = 0; i < kWords; ++i) {
+                    buf[i] = words_[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq_.load(std::memory_order_relaxed) == before) {
+                    break;
+                }
+            }
+            T value;
+            std::memcpy(&value, buf, sizeof(T));
+            return value;
+        }
+
+        // Number of completed writes; 0 means nothing has been published yet.
+        uint64_t version() const {
+            return seq_.load(std::memory_order_acquire) / 2;
+        }
+
+    private:
+        alignas(64) std::atomic<uint64_t> seq_;
+        std::atomic<uint64_t> words_[kWords];
+    };
+}
+
+#endif //SEQLOCK_H
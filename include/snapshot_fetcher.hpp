@@ -0,0 +1,46 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef SNAPSHOT_FETCHER_H
+#define SNAPSHOT_FETCHER_H
+
+#include "config.hpp"
+#include "market_data.hpp"
+#include <cpprest/http_client.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+namespace deribit {
+
+    // Serves MarketData resync requests from the REST `public/get_order_book`
+    // endpoint. Requests are asynchronous so the worker that detected the gap
+    // keeps draining its queue; the snapshot is handed back through
+    // MarketData::submit_snapshot() and applied by that same worker.
+    class SnapshotFetcher {
+    public:
+        SnapshotFetcher(Config& config, MarketData& market_data, int depth = 10000);
+        ~SnapshotFetcher();     // detaches from MarketData and waits for requests in flight
+
+        SnapshotFetcher(const SnapshotFetcher&) = delete;
+        SnapshotFetcher& operator=(const SnapshotFetcher&) = delete;
+
+        void request(InstrumentId id, const std::string& symbol);
+
+    private:
+        static bool to_snapshot(const web::json::value& response, InstrumentId id, BookUpdate& out);
+        void finish_request();
+
+        MarketData& market_data_;
+        web::http::client::http_client client_;
+        int depth_;
+
+        std::mutex in_flight_mutex_;
+        std::condition_variable in_flight_cv_;
+        size_t in_flight_ = 0;
+    };
+}
+
+#endif //SNAPSHOT_FETCHER_H
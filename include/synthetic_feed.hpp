@@ -0,0 +1,141 @@
+//
+// Created by Supradeep Chitumalla
+//
+// Deribit-shaped book.* frames, for the benchmarks when no recording is given
+// and for the startup warm-up.
+
+#ifndef SYNTHETIC_FEED_H
+#define SYNTHETIC_FEED_H
+
+#include "feed_recorder.hpp"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace deribit {
+
+    struct SyntheticFeedOptions {
+        std::string name_prefix = "SYN";    // instruments are <prefix><i>-PERPETUAL
+        size_t instruments = 4;
+        size_t depth = 50;                  // levels per side in the initial snapshot
+        size_t updates = 100000;            // change frames after the snapshots
+        size_t levels_per_update = 2;       // levels touched per change frame
+        double touch_bias = 0.3;            // geometric p of a level's distance from the mid; lower reaches deeper
+        int mid_move_percent = 5;           // change frames that move the mid a tick
+        double tick = 0.5;
+        double mid = 60000.0;
+        int64_t mean_gap_ns = 20000;        // spacing of receive_ns
+        uint32_t seed = 7;
+    };
+
+    // A random walk around each instrument's touch: mostly amount changes near
+    // the top, some new levels and deletes, and a mid that drifts by a tick now
+    // and then. change_id/prev_change_id chain per instrument like the real feed.
+    class SyntheticFeed {
+    public:
+        explicit SyntheticFeed(const SyntheticFeedOptions& options = SyntheticFeedOptions{})
+            : options_(options), rng_(options.seed) {}
+
+        std::string instrument_name(size_t i) const {
+            return options_.name_prefix + std::to_string(i) + "-PERPETUAL";
+        }
+
+        std::vector<RecordedFrame> generate() {
+            std::vector<RecordedFrame> frames;
+            frames.reserve(options_.instruments + options_.updates);
+
+            std::vector<Instrument> instruments(options_.instruments);
+            int64_t clock = 0;
+            for (size_t i = 0; i < instruments.size(); ++i) {
+                Instrument& inst = instruments[i];
+                inst.name = instrument_name(i);
+                inst.mid_ticks = static_cast<int64_t>(options_.mid / options_.tick) + static_cast<int64_t>(i) * 1000;
+                inst.change_id = 1000 + static_cast<int64_t>(i) * 1000000;
+                frames.push_back({clock, snapshot_frame(inst, clock)});
+                clock += options_.mean_gap_ns;
+            }
+
+            std::exponential_distribution<double> gap(1.0 / static_cast<double>(options_.mean_gap_ns));
+            std::uniform_int_distribution<size_t> pick(0, instruments.size() - 1);
+            for (size_t n = 0; n < options_.updates; ++n) {
+                clock += static_cast<int64_t>(gap(rng_)) + 1;
+                frames.push_back({clock, change_frame(instruments[pick(rng_)], clock)});
+            }
+            return frames;
+        }
+
+    private:
+        struct Instrument {
+            std::string name;
+            int64_t mid_ticks = 0;
+            int64_t change_id = 0;
+        };
+
+        std::string price(int64_t ticks) const {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.1f", static_cast<double>(ticks) * options_.tick);
+            return buf;
+        }
+
+        std::string amount() {
+            std::uniform_int_distribution<int> lots(1, 500);
+            return std::to_string(lots(rng_) * 10) + ".0";
+        }
+
+        std::string header(const Instrument& inst, const char* type, int64_t clock, bool with_prev) const {
+            std::string out = R"({"jsonrpc":"2.0","method":"subscription","params":{"channel":"book.)" + inst.name +
+                              R"(.raw","data":{"type":")" + type + R"(","timestamp":)" +
+                              std::to_string(1700000000000 + clock / 1000000);
+            if (with_prev) {
+                out += R"(,"prev_change_id":)" + std::to_string(inst.change_id - 1);
+            }
+            out += R"(,"instrument_name":")" + inst.name + R"(","change_id":)" + std::to_string(inst.change_id);
+            return out;
+        }
+
+        std::string snapshot_frame(Instrument& inst, int64_t clock) {
+            std::string out = header(inst, "snapshot", clock, false) + R"(,"bids":[)";
+            for (size_t i = 0; i < options_.depth; ++i) {
+                if (i) out += ',';
+                out += R"(["new",)" + price(inst.mid_ticks - 1 - static_cast<int64_t>(i)) + "," + amount() + "]";
+            }
+            out += R"(],"asks":[)";
+            for (size_t i = 0; i < options_.depth; ++i) {
+                if (i) out += ',';
+                out += R"(["new",)" + price(inst.mid_ticks + 1 + static_cast<int64_t>(i)) + "," + amount() + "]";
+            }
+            return out + "]}}}";
+        }
+
+        std::string change_frame(Instrument& inst, int64_t clock) {
+            std::uniform_int_distribution<int> percent(0, 99);
+            std::geometric_distribution<int> distance(options_.touch_bias);
+            if (percent(rng_) < options_.mid_move_percent) {
+                inst.mid_ticks += percent(rng_) < 50 ? 1 : -1;
+            }
+            ++inst.change_id;
+
+            std::string sides[2];
+            for (size_t n = 0; n < options_.levels_per_update; ++n) {
+                bool bid = percent(rng_) < 50;
+                int64_t offset = 1 + distance(rng_);
+                int64_t ticks = bid ? inst.mid_ticks - offset : inst.mid_ticks + offset;
+                int roll = percent(rng_);
+                std::string level = roll < 15
+                    ? R"(["delete",)" + price(ticks) + ",0.0]"
+                    : std::string(roll < 30 ? R"(["new",)" : R"(["change",)") + price(ticks) + "," + amount() + "]";
+                std::string& side = sides[bid ? 0 : 1];
+                if (!side.empty()) side += ',';
+                side += level;
+            }
+            return header(inst, "change", clock, true) + R"(,"bids":[)" + sides[0] + R"(],"asks":[)" + sides[1] + "]}}}";
+        }
+
+        SyntheticFeedOptions options_;
+        std::mt19937 rng_;
+    };
+}
+
+#endif //SYNTHETIC_FEED_H
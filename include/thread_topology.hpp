@@ -0,0 +1,75 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef THREAD_TOPOLOGY_H
+#define THREAD_TOPOLOGY_H
+
+#include "config.hpp"
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace deribit {
+
+    enum class ThreadRole {
+        Io,             // WebSocket receive thread
+        BookShard,      // MarketData workers; the strategy callback runs here too
+        OrderSend       // OrderManager workers
+    };
+
+    const char* to_string(ThreadRole role);
+
+    // Where each pipeline thread runs. Threads call pin_current_thread() first
+    // thing; the role's core list from Config::threading is indexed by the
+    // thread's index within its role (wrapping). Roles without cores are left
+    // to the scheduler but still named and listed in the report.
+    //
+    // Memory that a thread allocates and touches after pinning lands on that
+    // core's NUMA node under the default first-touch policy, which is how
+    // MarketData keeps shard queues and books local to their worker.
+    class ThreadTopology {
+    public:
+        static ThreadTopology& global() {
+            static ThreadTopology topology;
+            return topology;
+        }
+
+        // Call before any pipeline thread starts.
+        void configure(const Config::Threading& threading);
+        const Config::Threading& threading() const { return threading_; }
+
+        // Pins, names and (optionally) raises the priority of the calling
+        // thread. `name` is truncated to 15 characters. Returns the core, or -1.
+        int pin_current_thread(ThreadRole role, size_t index, const std::string& name);
+
+        // Core the role's index-th thread is (or would be) pinned to, or -1.
+        int core_for(ThreadRole role, size_t index) const;
+
+        // NUMA node of a core, or -1 if unknown (no NUMA, or not Linux).
+        static int numa_node_of_core(int core);
+
+        void print_report(std::ostream& out) const;
+
+    private:
+        struct Placement {
+            std::string name;
+            ThreadRole role;
+            int core;
+            int numa_node;
+            bool realtime;
+            std::string note;
+        };
+
+        ThreadTopology() = default;
+
+        const std::vector<int>& cores(ThreadRole role) const;
+
+        Config::Threading threading_;
+        mutable std::mutex mutex_;
+        std::vector<Placement> placements_;
+    };
+}
+
+#endif //THREAD_TOPOLOGY_H
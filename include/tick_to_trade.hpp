@@ -0,0 +1,105 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef TICK_TO_TRADE_H
+#define TICK_TO_TRADE_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+#include "latency_metrics.hpp"
+
+namespace deribit {
+
+    // Identifies the feed message an order was a reaction to. DeribitClient
+    // stamps id and receive_ticks when the frame arrives; MarketData hands
+    // them to the strategy on the Orderbook it publishes (Orderbook::trace);
+    // the strategy stamps decision_ticks and copies the whole thing into
+    // OrderParams::trace. Times are TscClock ticks.
+    struct TraceContext {
+        uint64_t id = 0;                // 0 = not from the feed; such orders are not timed
+        int64_t receive_ticks = 0;      // frame arrived
+        int64_t decision_ticks = 0;     // strategy decided to send the order
+    };
+
+    // Segments of one strategy-initiated order, in causal order.
+    enum class TradeSegment : uint8_t {
+        FeedToDecision,     // frame received -> strategy decided (decode, queue, apply, strategy)
+        DecisionToSend,     // decided -> an order worker sent the request (order queue)
+        SendToAck,          // request sent -> exchange response
+        Total               // frame received -> response (tick-to-trade)
+    };
+
+    constexpr size_t kTradeSegmentCount = 4;
+
+    inline const char* to_string(TradeSegment segment) {
+        switch (segment) {
+            case TradeSegment::FeedToDecision: return "Feed -> decision";
+            case TradeSegment::DecisionToSend: return "Decision -> send";
+            case TradeSegment::SendToAck: return "Send -> ack";
+            case TradeSegment::Total: return "Tick-to-trade";
+        }
+        return "unknown";
+    }
+
+    // For metric labels.
+    inline const char* to_label(TradeSegment segment) {
+        switch (segment) {
+            case TradeSegment::FeedToDecision: return "feed_to_decision";
+            case TradeSegment::DecisionToSend: return "decision_to_send";
+            case TradeSegment::SendToAck: return "send_to_ack";
+            case TradeSegment::Total: return "total";
+        }
+        return "unknown";
+    }
+
+    // Per-segment latency of traced orders, in TscClock ticks. Orders are
+    // rare next to book messages and come from several order workers, so
+    // the histograms are shared and written with record_concurrent().
+    class TickToTrade {
+    public:
+        TickToTrade() = default;
+        TickToTrade(const TickToTrade&) = delete;
+        TickToTrade& operator=(const TickToTrade&) = delete;
+
+        // Any thread. Untraced orders (id 0) are ignored.
+        void record(const TraceContext& trace, int64_t send_ticks, int64_t ack_ticks) {
+            if (trace.id == 0 || trace.receive_ticks == 0) {
+                return;
+            }
+            if (trace.decision_ticks) {
+                add(TradeSegment::FeedToDecision, trace.decision_ticks - trace.receive_ticks);
+                add(TradeSegment::DecisionToSend, send_ticks - trace.decision_ticks);
+            }
+            add(TradeSegment::SendToAck, ack_ticks - send_ticks);
+            add(TradeSegment::Total, ack_ticks - trace.receive_ticks);
+        }
+
+        const LatencyHistogram& histogram(TradeSegment segment) const {
+            return histograms_[static_cast<size_t>(segment)];
+        }
+
+        uint64_t orders() const { return histogram(TradeSegment::Total).count(); }
+
+        void print_summary(std::ostream& out) const {
+            LatencyTracker::print_latency_header(out, "Segment");
+            for (size_t i = 0; i < kTradeSegmentCount; ++i) {
+                TradeSegment segment = static_cast<TradeSegment>(i);
+                LatencyTracker::print_latency_row(out, to_string(segment),
+                                                  LatencyStats::from(histogram(segment).snapshot()));
+            }
+        }
+
+    private:
+        void add(TradeSegment segment, int64_t ticks) {
+            histograms_[static_cast<size_t>(segment)].record_concurrent(
+                static_cast<uint64_t>(ticks < 0 ? 0 : ticks));
+        }
+
+        std::array<LatencyHistogram, kTradeSegmentCount> histograms_;
+    };
+}
+
+#endif //TICK_TO_TRADE_H
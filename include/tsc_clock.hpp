@@ -0,0 +1,110 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef TSC_CLOCK_H
+#define TSC_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define DERIBIT_HAS_TSC 1
+#else
+#define DERIBIT_HAS_TSC 0
+#endif
+
+namespace deribit {
+
+    // Timestamps for instrumentation. On x86 with an invariant TSC, now() is
+    // a single rdtscp (~10 ns, no vDSO call, no conversion); everywhere else,
+    // or if the TSC fails calibration, it is steady_clock in nanoseconds.
+    // Either way now() returns ticks: only differences are meaningful, and
+    // they become nanoseconds through to_ns(), which belongs on the read side
+    // (when stats are printed), not where timestamps are taken.
+    //
+    // The TSC is calibrated against steady_clock once, on first use, which
+    // takes ~20 ms; call calibrate() at startup to keep that off the first
+    // message. The source never changes afterwards, so all ticks are
+    // comparable.
+    class TscClock {
+    public:
+        static int64_t now() {
+#if DERIBIT_HAS_TSC
+            if (state().tsc) {
+                unsigned int aux;
+                return static_cast<int64_t>(__rdtscp(&aux));
+            }
+#endif
+            return steady_ns();
+        }
+
+        static int64_t to_ns(int64_t ticks) {
+            return static_cast<int64_t>(static_cast<double>(ticks) * state().ns_per_tick);
+        }
+
+        static double ns_per_tick() { return state().ns_per_tick; }
+
+        // True if now() reads the TSC.
+        static bool using_tsc() { return state().tsc; }
+
+        static void calibrate() { state(); }
+
+    private:
+        struct State {
+            bool tsc = false;
+            double ns_per_tick = 1.0;
+        };
+
+        static const State& state() {
+            static const State s = measure();
+            return s;
+        }
+
+        static int64_t steady_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        static State measure() {
+            State s;
+#if DERIBIT_HAS_TSC
+            // CPUID.80000007H:EDX[8]: the TSC ticks at a constant rate in every
+            // P-, C- and T-state, so it can be used as a clock at all.
+            unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+            if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) {
+                return s;
+            }
+
+            // Two back-to-back rounds; the rate is trusted only if they agree.
+            double rate[2];
+            for (double& r : rate) {
+                unsigned int aux;
+                int64_t ns0 = steady_ns();
+                uint64_t tsc0 = __rdtscp(&aux);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                int64_t ns1 = steady_ns();
+                uint64_t tsc1 = __rdtscp(&aux);
+                if (ns1 <= ns0 || tsc1 <= tsc0) {
+                    return s;
+                }
+                r = static_cast<double>(ns1 - ns0) / static_cast<double>(tsc1 - tsc0);
+            }
+            double ns_per_tick = (rate[0] + rate[1]) / 2;
+            bool stable = rate[0] > rate[1] ? rate[0] - rate[1] < 0.001 * ns_per_tick
+                                            : rate[1] - rate[0] < 0.001 * ns_per_tick;
+            bool plausible = ns_per_tick > 0.1 && ns_per_tick < 10.0;     // 100 MHz .. 10 GHz
+            if (stable && plausible) {
+                s.tsc = true;
+                s.ns_per_tick = ns_per_tick;
+            }
+#endif
+            return s;
+        }
+    };
+}
+
+#endif //TSC_CLOCK_H
@@ -0,0 +1,172 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef WAIT_STRATEGY_H
+#define WAIT_STRATEGY_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace deribit {
+
+    // Tells the core we are in a spin loop: cheaper for the sibling
+    // hyperthread and avoids the memory-order flush when the loop exits.
+    inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#else
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+    }
+
+    enum class WaitKind {
+        BusySpin,       // pause and poll again; lowest wake-up latency, one core at 100%
+        SpinYield,      // spin, then yield the core between polls
+        SpinPark,       // spin, then sleep until a producer calls notify()
+        TimedSleep      // sleep a fixed interval between polls
+    };
+
+    struct WaitConfig {
+        WaitKind kind = WaitKind::SpinPark;
+        uint32_t spin_polls = 2000;                         // empty polls before yielding/parking
+        std::chrono::microseconds sleep{100};               // TimedSleep interval
+        std::chrono::microseconds park_timeout{1000};       // SpinPark: bounds a missed wake-up and lets
+                                                            // the consumer re-check things notify() does not cover
+    };
+
+    inline const char* to_string(WaitKind kind) {
+        switch (kind) {
+            case WaitKind::BusySpin: return "busy-spin";
+            case WaitKind::SpinYield: return "spin-yield";
+            case WaitKind::SpinPark: return "spin-park";
+            case WaitKind::TimedSleep: return "timed-sleep";
+        }
+        return "unknown";
+    }
+
+    // What a consumer does when it polls its queue and finds nothing. One
+    // instance is shared by a queue's producers and consumers: consumers call
+    // idle() after each empty poll, producers call notify() after publishing.
+    //
+    // notify() costs a fence and one load unless a consumer is actually
+    // parked (and nothing at all for the kinds that never park), so producers
+    // can call it unconditionally.
+    class WaitStrategy {
+    public:
+        explicit WaitStrategy(const WaitConfig& config = WaitConfig{}) : config_(config) {}
+
+        WaitStrategy(const WaitStrategy&) = delete;
+        WaitStrategy& operator=(const WaitStrategy&) = delete;
+
+        const WaitConfig& config() const { return config_; }
+
+        // Consumer. `idle_polls` counts consecutive empty polls and belongs to
+        // the calling thread; reset it to 0 whenever work is found. `ready()`
+        // re-checks the queue before parking so a concurrent push is not missed.
+        template<typename Ready>
+        void idle(uint32_t& idle_polls, Ready&& ready) {
+            ++idle_polls;
+            switch (config_.kind) {
+                case WaitKind::BusySpin:
+                    cpu_relax();
+                    return;
+                case WaitKind::SpinYield:
+                    if (idle_polls < config_.spin_polls) {
+                        cpu_relax();
+                    } else {
+                        std::this_thread::yield();
+                    }
+                    return;
+                case WaitKind::SpinPark:
+                    if (idle_polls < config_.spin_polls) {
+                        cpu_relax();
+                    } else {
+                        park(ready);
+                    }
+                    return;
+                case WaitKind::TimedSleep:
+                    std::this_thread::sleep_for(config_.sleep);
+                    return;
+            }
+        }
+
+        // Producer, after the work is visible in the queue.
+        void notify() {
+            if (config_.kind != WaitKind::SpinPark) {
+                return;     // nobody ever parks
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepers_.load(std::memory_order_relaxed) == 0) {
+                return;
+            }
+            wake_all();
+        }
+
+        // Wakes every parked consumer regardless (shutdown).
+        void wake_all() {
+            epoch_.fetch_add(1, std::memory_order_seq_cst);
+#if defined(__linux__)
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, INT_MAX,
+                    nullptr, nullptr, 0);
+#else
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_all();
+#endif
+        }
+
+    private:
+        // Classic eventcount: read the epoch, announce ourselves, re-check, then
+        // sleep only if the epoch has not moved. A producer either sees our
+        // announcement and bumps the epoch, or we see its push in ready().
+        template<typename Ready>
+        void park(Ready& ready) {
+            uint32_t key = epoch_.load(std::memory_order_seq_cst);
+            sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            if (!ready()) {
+#if defined(__linux__)
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(config_.park_timeout).count();
+                timespec timeout{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, key,
+                        &timeout, nullptr, 0);
+#else
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait_for(lock, config_.park_timeout, [&] {
+                    return epoch_.load(std::memory_order_seq_cst) != key;
+                });
+#endif
+            }
+            sleepers_.fetch_sub(1, std::memory_order_seq_cst);
+        }
+
+        WaitConfig config_;
+        alignas(64) std::atomic<uint32_t> epoch_{0};
+        std::atomic<uint32_t> sleepers_{0};
+#if !defined(__linux__)
+        std::mutex mutex_;
+        std::condition_variable cv_;
+#endif
+    };
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+}
+
+#endif //WAIT_STRATEGY_H
@@ -0,0 +1,62 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include "config.hpp"
+#include "market_data.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace deribit {
+
+    struct WarmupWindow {
+        size_t updates = 0;         // cumulative, at the end of the window
+        int64_t p50_ns = 0;
+        int64_t p99_ns = 0;
+        int64_t max_ns = 0;
+    };
+
+    struct WarmupReport {
+        bool memory_locked = false;
+        bool steady = false;        // latency settled before max_updates
+        size_t updates = 0;         // synthetic updates run
+        size_t lost = 0;            // updates whose callback never came
+        std::vector<WarmupWindow> windows;
+    };
+
+    // Gets the book path hot before anything trades on it.
+    //
+    // First the memory side: optionally mlockall(), then MarketData::prepare_memory()
+    // (queue rings faulted in and offered huge pages, every slot's level vectors
+    // reserved, shard scratch arenas touched). Then a synthetic Deribit feed is
+    // pushed one frame at a time through the same decode -> queue -> apply ->
+    // publish -> callback path the live feed takes, from a thread pinned like
+    // the IO thread. This warms the caches, branch predictors, book pools and
+    // queue slots. Each frame's decode-to-callback latency is sampled in
+    // windows, and the run stops once three consecutive window medians agree
+    // within Config::Warmup::tolerance.
+    //
+    // Run it after MarketData is built and before subscribing: the warm-up is
+    // the only producer while it runs. The synthetic instruments are named
+    // WARMUP<i>-PERPETUAL and stay registered, idle, afterwards, but are left
+    // out of the per-instrument reports; when it ends MarketData's counts and
+    // stage latencies are restarted, so none of its traffic is reported as
+    // live. `strategy` sees their updates too (so its code is warm) and is
+    // installed as the MarketData update callback when the warm-up ends.
+    class Warmup {
+    public:
+        Warmup(MarketData& market_data, const Config::Warmup& config)
+            : market_data_(market_data), config_(config) {}
+
+        WarmupReport run(OrderBookUpdateCallback strategy = nullptr);
+
+    private:
+        MarketData& market_data_;
+        Config::Warmup config_;
+    };
+}
+
+#endif //WARMUP_H
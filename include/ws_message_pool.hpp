@@ -0,0 +1,171 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#ifndef WS_MESSAGE_POOL_H
+#define WS_MESSAGE_POOL_H
+
+#include <websocketpp/common/memory.hpp>
+#include <websocketpp/config/asio_client.hpp>
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/frame.hpp>
+#include <websocketpp/message_buffer/message.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace deribit {
+
+    // Per-connection message manager that recycles websocketpp messages.
+    //
+    // The stock manager make_shared()s a message and a payload string sized to
+    // the frame for every frame in either direction, and frees both when the
+    // handler returns, so every tick costs a malloc/free pair and, for a frame
+    // bigger than anything recent, fresh pages to fault in. Here messages live
+    // in a pool owned by the connection; one is handed out again once the pool
+    // holds the only reference to it. Its payload is cleared but keeps its
+    // capacity, so buffers settle at the largest frame they have carried and
+    // the handler parses straight out of a warm buffer.
+    //
+    // get_message() is called from the IO thread for inbound frames and from
+    // any thread that sends, hence the mutex. It is uncontended in practice.
+    template<typename Message>
+    class PooledMessageManager : public websocketpp::lib::enable_shared_from_this<PooledMessageManager<Message>> {
+    public:
+        using type = PooledMessageManager<Message>;
+        using ptr = websocketpp::lib::shared_ptr<type>;
+        using weak_ptr = websocketpp::lib::weak_ptr<type>;
+        using message_ptr = typename Message::ptr;
+
+        static constexpr size_t kMaxPooled = 64;                // beyond this, extra messages are not kept
+        static constexpr size_t kPrewarmed = 8;
+        static constexpr size_t kInitialPayload = 16 * 1024;
+
+        message_ptr get_message() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (message_ptr msg = take_free()) {
+                return msg;
+            }
+            return keep(websocketpp::lib::make_shared<Message>(this->shared_from_this()));
+        }
+
+        message_ptr get_message(websocketpp::frame::opcode::value op, size_t size) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (message_ptr msg = take_free()) {
+                msg->set_opcode(op);
+                std::string& payload = msg->get_raw_payload();
+                if (payload.capacity() < size) {
+                    payload.reserve(size);
+                }
+                return msg;
+            }
+            return keep(websocketpp::lib::make_shared<Message>(this->shared_from_this(), op,
+                                                               std::max(size, kInitialPayload)));
+        }
+
+        // Called by message::recycle(); the pool reclaims messages itself.
+        bool recycle(Message*) { return false; }
+
+        size_t pooled() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return pool_.size();
+        }
+
+    private:
+        // A pooled message nobody else references, reset for reuse. The first
+        // call also allocates and touches the first kPrewarmed buffers; that is
+        // normally the subscribe request, before any book frame arrives.
+        message_ptr take_free() {
+            if (pool_.empty()) {
+                prewarm();
+            }
+            for (message_ptr& msg : pool_) {
+                if (msg.use_count() == 1) {
+                    // The last other owner released its reference with a
+                    // release decrement; see its writes before reusing the buffer.
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    reset(*msg);
+                    return msg;
+                }
+            }
+            return nullptr;
+        }
+
+        void prewarm() {
+            pool_.reserve(kMaxPooled);
+            for (size_t i = 0; i < kPrewarmed; ++i) {
+                message_ptr msg = websocketpp::lib::make_shared<Message>(this->shared_from_this(),
+                    websocketpp::frame::opcode::text, kInitialPayload);
+                std::string& payload = msg->get_raw_payload();
+                payload.resize(kInitialPayload);     // fault the pages in now
+                payload.clear();
+                pool_.push_back(std::move(msg));
+            }
+        }
+
+        message_ptr keep(message_ptr msg) {
+            if (pool_.size() < kMaxPooled) {
+                pool_.push_back(msg);
+            }
+            return msg;
+        }
+
+        static void reset(Message& msg) {
+            msg.set_header("");
+            msg.set_prepared(false);
+            msg.set_fin(true);
+            msg.set_terminal(false);
+            msg.set_compressed(false);
+            msg.get_raw_payload().clear();
+        }
+
+        mutable std::mutex mutex_;
+        std::vector<message_ptr> pool_;
+    };
+
+    // websocketpp connections construct their con_msg_manager themselves; this
+    // only has to exist for the config.
+    template<typename ConManager>
+    class PooledEndpointMessageManager {
+    public:
+        using con_msg_man_ptr = typename ConManager::ptr;
+
+        con_msg_man_ptr get_manager() const {
+            return websocketpp::lib::make_shared<ConManager>();
+        }
+    };
+
+#ifdef DERIBIT_POOLED_WS_MESSAGES
+    // asio_tls_client with pooled message buffers.
+    struct DeribitTlsConfig : public websocketpp::config::asio_tls_client {
+        using type = DeribitTlsConfig;
+        using base = websocketpp::config::asio_tls_client;
+
+        using message_type = websocketpp::message_buffer::message<PooledMessageManager>;
+        using con_msg_manager_type = PooledMessageManager<message_type>;
+        using endpoint_msg_manager_type = PooledEndpointMessageManager<con_msg_manager_type>;
+    };
+
+    // The same without TLS, for ws:// endpoints such as a local feed_simulator.
+    // Same message type, so both deliver the same message_ptr.
+    struct DeribitPlainConfig : public websocketpp::config::asio_client {
+        using type = DeribitPlainConfig;
+        using base = websocketpp::config::asio_client;
+        using message_type = DeribitTlsConfig::message_type;
+        using con_msg_manager_type = DeribitTlsConfig::con_msg_manager_type;
+        using endpoint_msg_manager_type = DeribitTlsConfig::endpoint_msg_manager_type;
+    };
+#else
+    // The stock configs (and the stock per-frame allocation) unless the build
+    // opts in with -DDERIBIT_POOLED_WS_MESSAGES=ON: PooledMessageManager has
+    // only been checked against a stand-in for websocketpp's message, not
+    // built against websocketpp itself. Both share the stock message_type.
+    using DeribitTlsConfig = websocketpp::config::asio_tls_client;
+    using DeribitPlainConfig = websocketpp::config::asio_client;
+#endif
+}
+
+#endif //WS_MESSAGE_POOL_H
@@ -2,6 +2,12 @@
 #include "config.hpp"
 #include "config_loader.hpp"
 #include "deribit_client.hpp"
+#include "snapshot_fetcher.hpp"
+#include "thread_topology.hpp"
+#include "tsc_clock.hpp"
+#include "event_trace.hpp"
+#include "warmup.hpp"
+#include "metrics_server.hpp"
 #include "order.hpp"
 #include "authentication.hpp"
 #include <iostream>
@@ -37,8 +43,10 @@ public:
         std::cout << "7. View latency metrics" << std::endl;
         std::cout << "8. Subscribe to symbol" << std::endl;
         std::cout << "9. Exit" << std::endl;
+        std::cout << "10. Start/stop feed recording" << std::endl;
+        std::cout << "11. Dump event trace" << std::endl;
         std::cout << std::string(50, '=') << std::endl;
-        std::cout << "Enter your choice (1-9): ";
+        std::cout << "Enter your choice (1-11): ";
     }
 
     void handle_buy_order() {
@@ -300,9 +308,8 @@ public:
         std::cout << "Enter symbol (e.g., BTC-PERPETUAL): ";
         std::cin >> symbol;
 
-        auto orderbook = market_data_.get_orderbook(symbol);
-
-        if (orderbook.instrument_name.empty()) {
+        deribit::DepthSnapshot depth;
+        if (!market_data_.get_depth(symbol, depth)) {
             std::cout << "No orderbook data available for " << symbol << std::endl;
             std::cout << "Make sure you're subscribed to this symbol's market data." << std::endl;
             return;
@@ -310,21 +317,49 @@ public:
 
         std::cout << "Orderbook for " << symbol << ":" << std::endl;
         std::cout << std::string(40, '-') << std::endl;
-        std::cout << "Timestamp: " << orderbook.timestamp << std::endl;
-        std::cout << "Best Bid: " << std::fixed << std::setprecision(2)
-                  << orderbook.best_bid_price << " (" << orderbook.best_bid_amount << ")" << std::endl;
-        std::cout << "Best Ask: " << orderbook.best_ask_price << " (" << orderbook.best_ask_amount << ")" << std::endl;
-
-        if (orderbook.best_ask_price > 0 && orderbook.best_bid_price > 0) {
-            double spread = orderbook.best_ask_price - orderbook.best_bid_price;
-            double spread_pct = (spread / orderbook.best_bid_price) * 100;
+        std::cout << "Timestamp: " << depth.timestamp << std::endl;
+        if (depth.stale) {
+            std::cout << "⚠️  Book is resyncing after a sequence gap; levels may be out of date" << std::endl;
+        }
+        std::cout << std::fixed << std::setprecision(2);
+
+        double best_bid = depth.bid_count > 0 ? depth.bids[0].price : 0.0;
+        double best_ask = depth.ask_count > 0 ? depth.asks[0].price : 0.0;
+        std::cout << "Best Bid: " << best_bid << " (" << (depth.bid_count > 0 ? depth.bids[0].amount : 0.0) << ")" << std::endl;
+        std::cout << "Best Ask: " << best_ask << " (" << (depth.ask_count > 0 ? depth.asks[0].amount : 0.0) << ")" << std::endl;
+
+        if (best_ask > 0 && best_bid > 0) {
+            double spread = best_ask - best_bid;
+            double spread_pct = (spread / best_bid) * 100;
             std::cout << "Spread: " << spread << " (" << std::setprecision(4) << spread_pct << "%)" << std::endl;
+            std::cout << std::setprecision(2);
+        }
+
+        const size_t levels = 5;
+        std::cout << std::string(40, '-') << std::endl;
+        std::cout << std::setw(18) << "BID" << " | " << "ASK" << std::endl;
+        for (size_t i = 0; i < levels && (i < depth.bid_count || i < depth.ask_count); ++i) {
+            if (i < depth.bid_count) {
+                std::cout << std::setw(8) << depth.bids[i].amount << " @ " << std::setw(9) << depth.bids[i].price;
+            } else {
+                std::cout << std::string(20, ' ');
+            }
+            std::cout << " | ";
+            if (i < depth.ask_count) {
+                std::cout << depth.asks[i].price << " x " << depth.asks[i].amount;
+            }
+            std::cout << std::endl;
         }
 
         size_t dropped = market_data_.get_dropped_message_count();
         if (dropped > 0) {
             std::cout << "⚠️  Dropped messages: " << dropped << std::endl;
         }
+        size_t conflated = market_data_.get_conflated_message_count();
+        if (conflated > 0) {
+            std::cout << "Conflated messages: " << conflated
+                      << " (max depth " << market_data_.get_max_conflation_depth() << ")" << std::endl;
+        }
     }
 
     void handle_coin_subscribe() {
@@ -338,9 +373,59 @@ public:
         }
     }
 
+    void handle_feed_recording() {
+        if (!deribit_client_) {
+            std::cout << "No market data connection." << std::endl;
+            return;
+        }
+        if (deribit_client_->is_recording()) {
+            size_t frames = deribit_client_->stop_recording();
+            std::cout << "Recording stopped, " << frames << " frames written." << std::endl;
+            return;
+        }
+
+        std::string path;
+        std::cout << "Enter file to record to (e.g., feed.rec): ";
+        std::cin >> path;
+        try {
+            deribit_client_->start_recording(path);
+            std::cout << "Recording to " << path << ". Replay it with bench_pipeline." << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+        }
+    }
+
+    void handle_trace_dump() {
+        deribit::EventTracer& tracer = deribit::EventTracer::global();
+        if (!tracer.enabled()) {
+            std::cout << "Event tracing is off; enable it under \"trace\" in config.json." << std::endl;
+            return;
+        }
+        std::string path;
+        std::cout << "Enter file to dump to (e.g., trace.bin): ";
+        std::cin >> path;
+        try {
+            size_t events = tracer.dump(path);
+            std::cout << "Wrote " << events << " events to " << path
+                      << ". Convert with trace_to_chrome for Perfetto." << std::endl;
+        } catch (const std::exception& e) {
+            std::cout << e.what() << std::endl;
+        }
+        if (config_.trace.trigger_us > 0) {
+            tracer.arm_trigger(config_.trace.trigger_us * 1000, config_.trace.path);
+            std::cout << "Trace trigger re-armed at " << config_.trace.trigger_us << " us." << std::endl;
+        }
+    }
+
     void handle_view_latency() {
         std::cout << "\nLATENCY METRICS" << std::endl;
         market_data_.print_latency_stats();
+
+        const deribit::TickToTrade& tick_to_trade = order_manager_.tick_to_trade();
+        std::cout << "\nTick-to-trade (strategy orders: " << tick_to_trade.orders() << ")" << std::endl;
+        if (tick_to_trade.orders() > 0) {
+            tick_to_trade.print_summary(std::cout);
+        }
     }
 
     void run() {
@@ -378,8 +463,14 @@ public:
                 case 9:
                     std::cout << "Exiting trading interface..." << std::endl;
                     break;
+                case 10:
+                    handle_feed_recording();
+                    break;
+                case 11:
+                    handle_trace_dump();
+                    break;
                 default:
-                    std::cout << "Invalid choice! Please enter 1-9." << std::endl;
+                    std::cout << "Invalid choice! Please enter 1-11." << std::endl;
                     break;
             }
 
@@ -418,7 +509,24 @@ int main(int argc, char* argv[]) {
     }
     std::cout << "Authentication successful!" << std::endl;
 
-    deribit::MarketData market_data;
+    // Must be in place before any pipeline thread starts; each thread pins itself.
+    deribit::ThreadTopology::global().configure(config.threading);
+
+    // Calibrate the instrumentation clock now rather than on the first message.
+    deribit::TscClock::calibrate();
+    std::cout << "Timestamps: " << (deribit::TscClock::using_tsc() ? "invariant TSC" : "steady_clock")
+              << std::endl;
+    deribit::EventTracer::global().configure(config.trace.enabled, config.trace.ring_events);
+
+    // One worker per shard; each symbol is always applied by the same worker, in order.
+    // Bursts that outrun a worker are conflated per instrument rather than dropped.
+    // Idle shard workers spin briefly and then park, so quiet feeds do not burn a core each.
+    deribit::WaitConfig feed_wait;
+    feed_wait.kind = deribit::WaitKind::SpinPark;
+    deribit::MarketData market_data(4, 65536, deribit::RoutingMode::Sharded,
+                                    deribit::BackpressureMode::Conflate, feed_wait);
+    // Books that miss a change_id are rebuilt from a REST snapshot.
+    deribit::SnapshotFetcher snapshot_fetcher(config, market_data);
     deribit::DeribitClient deribit_client(config, &market_data);
 
     std::cout << "Connecting to Deribit WebSocket..." << std::endl;
@@ -431,7 +539,34 @@ int main(int argc, char* argv[]) {
     }
     std::cout << "WebSocket connected!" << std::endl;
 
-    deribit::OrderManager order_manager(config, 4, 1024);
+    // Orders are latency-critical: spin longer before parking than the feed workers do.
+    deribit::WaitConfig order_wait;
+    order_wait.kind = deribit::WaitKind::SpinPark;
+    order_wait.spin_polls = 200000;
+    deribit::OrderManager order_manager(config, 4, 1024, order_wait);
+
+    // Nothing is subscribed yet, so the synthetic warm-up feed has the book
+    // path to itself. Trading is only offered once it has settled.
+    if (config.warmup.enabled) {
+        deribit::Warmup warmup(market_data, config.warmup);
+        deribit::WarmupReport report = warmup.run();
+        if (!report.steady) {
+            std::cout << "Warning: latency had not settled after " << report.updates
+                      << " warm-up updates" << std::endl;
+        }
+    }
+
+    // Served only once the warm-up has restarted MarketData's counters, so no
+    // scrape ever sees an exported counter go back to zero.
+    deribit::MetricsServer metrics(config.server.websocket_port, market_data, &order_manager);
+    if (config.server.websocket_port > 0 && metrics.start()) {
+        std::cout << "Metrics: " << metrics.url() << std::endl;
+    }
+
+    // Armed after warm-up, whose first messages are slow by design.
+    if (config.trace.enabled && config.trace.trigger_us > 0) {
+        deribit::EventTracer::global().arm_trigger(config.trace.trigger_us * 1000, config.trace.path);
+    }
 
     std::cout << "\n" << std::string(60, '=') << std::endl;
     std::cout << "SYSTEM READY FOR TRADING!" << std::endl;
@@ -439,6 +574,7 @@ int main(int argc, char* argv[]) {
     std::cout << "Market Data: Connected and streaming" << std::endl;
     std::cout << "Authentication: Active" << std::endl;
     std::cout << std::string(60, '=') << std::endl;
+    deribit::ThreadTopology::global().print_report(std::cout);
 
     TradingInterface interface(config, order_manager, market_data, &deribit_client);
     interface.run();
@@ -0,0 +1,287 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#include "book_decoder.hpp"
+#include <charconv>
+#include <cstdlib>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace deribit {
+
+    namespace {
+
+        // Finds the next '"' or '\\' from p. Strings are the bulk of what we skip
+        // (keys, channel names, actions), so scan 16 bytes at a time where we can.
+        inline const char* scan_string_end(const char* p, const char* end) {
+#if defined(__SSE2__)
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            while (end - p >= 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                          _mm_cmpeq_epi8(chunk, backslash)));
+                if (mask != 0) {
+                    return p + __builtin_ctz(static_cast<unsigned>(mask));
+                }
+                p += 16;
+            }
+#endif
+            while (p < end && *p != '"' && *p != '\\') ++p;
+            return p;
+        }
+
+        struct Cursor {
+            const char* p;
+            const char* end;
+
+            void skip_ws() {
+                while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) ++p;
+            }
+
+            bool peek(char c) {
+                skip_ws();
+                return p < end && *p == c;
+            }
+
+            bool consume(char c) {
+                if (!peek(c)) return false;
+                ++p;
+                return true;
+            }
+
+            // Returns the raw bytes between the quotes. Escapes are skipped over
+            // but not decoded; nothing the book path compares against uses them.
+            bool parse_string(std::string_view& out) {
+                if (!consume('"')) return false;
+                const char* start = p;
+                while (true) {
+                    const char* q = scan_string_end(p, end);
+                    if (q >= end) return false;
+                    if (*q == '\\') {
+                        p = q + 2;
+                        continue;
+                    }
+                    out = std::string_view(start, static_cast<size_t>(q - start));
+                    p = q + 1;
+                    return true;
+                }
+            }
+
+            bool parse_double(double& out) {
+                skip_ws();
+#if defined(__cpp_lib_to_chars)
+                auto [ptr, ec] = std::from_chars(p, end, out);
+                if (ec != std::errc()) return false;
+                p = ptr;
+#else
+                char* ptr = nullptr;
+                out = std::strtod(p, &ptr);
+                if (ptr == p) return false;
+                p = ptr;
+#endif
+                return true;
+            }
+
+            bool parse_int(int64_t& out) {
+                skip_ws();
+                const char* start = p;
+                bool negative = p < end && *p == '-';
+                if (negative) ++p;
+
+                int64_t value = 0;
+                const char* digits = p;
+                while (p < end && *p >= '0' && *p <= '9') {
+                    value = value * 10 + (*p - '0');
+                    ++p;
+                }
+                if (p == digits) return false;
+
+                if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) {
+                    p = start;
+                    double d;
+                    if (!parse_double(d)) return false;
+                    out = static_cast<int64_t>(d);
+                    return true;
+                }
+                out = negative ? -value : value;
+                return true;
+            }
+
+            bool skip_value() {
+                skip_ws();
+                if (p >= end) return false;
+
+                if (*p == '"') {
+                    std::string_view ignored;
+                    return parse_string(ignored);
+                }
+
+                if (*p == '{' || *p == '[') {
+                    int depth = 0;
+                    while (p < end) {
+                        char c = *p;
+                        if (c == '"') {
+                            std::string_view ignored;
+                            if (!parse_string(ignored)) return false;
+                            continue;
+                        }
+                        if (c == '{' || c == '[') {
+                            ++depth;
+                        } else if (c == '}' || c == ']') {
+                            if (--depth == 0) {
+                                ++p;
+                                return true;
+                            }
+                        }
+                        ++p;
+                    }
+                    return false;
+                }
+
+                // number / true / false / null
+                const char* start = p;
+                while (p < end && *p != ',' && *p != '}' && *p != ']' &&
+                       *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') {
+                    ++p;
+                }
+                return p != start;
+            }
+        };
+
+        // Calls fn(key) for every member; fn must consume the value.
+        template<typename Fn>
+        bool for_each_member(Cursor& c, Fn&& fn) {
+            if (!c.consume('{')) return false;
+            if (c.consume('}')) return true;
+            while (true) {
+                std::string_view key;
+                if (!c.parse_string(key) || !c.consume(':')) return false;
+                if (!fn(key)) return false;
+                if (c.consume(',')) continue;
+                return c.consume('}');
+            }
+        }
+
+        template<typename Fn>
+        bool for_each_element(Cursor& c, Fn&& fn) {
+            if (!c.consume('[')) return false;
+            if (c.consume(']')) return true;
+            while (true) {
+                if (!fn()) return false;
+                if (c.consume(',')) continue;
+                return c.consume(']');
+            }
+        }
+
+        bool parse_action(std::string_view text, LevelAction& action) {
+            if (text == "new") {
+                action = LevelAction::New;
+            } else if (text == "change") {
+                action = LevelAction::Change;
+            } else if (text == "delete") {
+                action = LevelAction::Delete;
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        // Levels come as ["new"|"change"|"delete", price, amount] on the raw
+        // book channels and as [price, amount] on the aggregated ones.
+        bool decode_levels(Cursor& c, std::vector<BookLevel>& levels) {
+            return for_each_element(c, [&]() {
+                if (!c.consume('[')) return false;
+
+                BookLevel level;
+                if (c.peek('"')) {
+                    std::string_view action;
+                    if (!c.parse_string(action) || !parse_action(action, level.action) || !c.consume(',')) {
+                        return false;
+                    }
+                }
+                if (!c.parse_double(level.price) || !c.consume(',') || !c.parse_double(level.amount)) {
+                    return false;
+                }
+                while (c.consume(',')) {
+                    if (!c.skip_value()) return false;
+                }
+                if (!c.consume(']')) return false;
+
+                levels.push_back(level);
+                return true;
+            });
+        }
+
+        bool decode_data(Cursor& c, BookUpdate& out, std::string_view& instrument) {
+            return for_each_member(c, [&](std::string_view key) {
+                if (key == "type") {
+                    std::string_view type;
+                    if (!c.parse_string(type)) return false;
+                    out.type = (type == "snapshot") ? BookUpdateType::Snapshot : BookUpdateType::Change;
+                    return true;
+                }
+                if (key == "timestamp") return c.parse_int(out.timestamp);
+                if (key == "change_id") return c.parse_int(out.change_id);
+                if (key == "prev_change_id") return c.parse_int(out.prev_change_id);
+                if (key == "instrument_name") {
+                    return c.parse_string(instrument);
+                }
+                if (key == "bids") return decode_levels(c, out.bids);
+                if (key == "asks") return decode_levels(c, out.asks);
+                return c.skip_value();
+            });
+        }
+    }
+
+    DecodeStatus BookDecoder::decode(std::string_view payload, BookUpdate& out) {
+        out.clear();
+
+        Cursor c{payload.data(), payload.data() + payload.size()};
+        std::string_view channel;
+        std::string_view instrument;
+        bool has_data = false;
+
+        bool ok = for_each_member(c, [&](std::string_view key) {
+            if (key != "params" || !c.peek('{')) {
+                return c.skip_value();
+            }
+            return for_each_member(c, [&](std::string_view param) {
+                if (param == "channel") {
+                    return c.parse_string(channel);
+                }
+                if (param == "data" && c.peek('{')) {
+                    has_data = true;
+                    return decode_data(c, out, instrument);
+                }
+                return c.skip_value();
+            });
+        });
+
+        if (!ok) {
+            return DecodeStatus::Malformed;
+        }
+        if (!has_data || channel.substr(0, 5) != "book.") {
+            return DecodeStatus::NotBook;
+        }
+
+        // Aggregated channels may omit instrument_name; fall back to the channel:
+        // "book.BTC-PERPETUAL.100ms" -> "BTC-PERPETUAL"
+        if (instrument.empty()) {
+            std::string_view rest = channel.substr(5);
+            size_t dot = rest.find('.');
+            if (dot == std::string_view::npos) {
+                return DecodeStatus::Malformed;
+            }
+            instrument = rest.substr(0, dot);
+        }
+
+        if (instruments_) {
+            out.instrument_id = instruments_->find(instrument);
+        }
+        return DecodeStatus::Book;
+    }
+}
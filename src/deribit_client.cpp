@@ -3,42 +3,51 @@
 //
 
 #include "deribit_client.hpp"
+#include "thread_topology.hpp"
+#include "scratch_arena.hpp"
+#include "event_trace.hpp"
 #include <websocketpp/common/thread.hpp>
 #include <asio/ssl/context.hpp>
 
 namespace deribit {
 
-    DeribitClient::DeribitClient(Config &cfg, MarketData* mdm)
-        : config_(cfg), market_manager_(mdm), is_connected_(false) {
-
-        // Initialize WebSocket client
-        ws_client_.clear_access_channels(websocketpp::log::alevel::all);
-        ws_client_.clear_error_channels(websocketpp::log::elevel::all);
-        ws_client_.init_asio();
+    template<typename Endpoint>
+    void DeribitClient::init_endpoint(Endpoint& endpoint) {
+        endpoint.clear_access_channels(websocketpp::log::alevel::all);
+        endpoint.clear_error_channels(websocketpp::log::elevel::all);
+        endpoint.init_asio();
 
         // Set up handlers
-        ws_client_.set_message_handler([this](connection_hdl hdl, client::message_ptr msg){
+        endpoint.set_message_handler([this](connection_hdl hdl, message_ptr msg){
             on_message(hdl, msg);
         });
 
-        ws_client_.set_open_handler([this](connection_hdl hdl){
+        endpoint.set_open_handler([this](connection_hdl hdl){
             std::lock_guard<std::mutex> lock(connection_mutex_);
             is_connected_ = true;
             connection_hdl_ = hdl;
             std::cout << "Connected to Deribit WebSocket!" << std::endl;
         });
 
-        ws_client_.set_close_handler([this](connection_hdl){
+        endpoint.set_close_handler([this](connection_hdl){
             std::lock_guard<std::mutex> lock(connection_mutex_);
             is_connected_ = false;
             std::cout << "Disconnected from Deribit WebSocket!" << std::endl;
         });
 
-        ws_client_.set_fail_handler([this](connection_hdl){
+        endpoint.set_fail_handler([this](connection_hdl){
             std::lock_guard<std::mutex> lock(connection_mutex_);
             is_connected_ = false;
             std::cout << "Failed to connect to Deribit WebSocket!" << std::endl;
         });
+    }
+
+    DeribitClient::DeribitClient(Config &cfg, MarketData* mdm)
+        : config_(cfg), market_manager_(mdm), is_connected_(false),
+          book_decoder_(mdm ? &mdm->instruments() : nullptr) {
+
+        init_endpoint(ws_client_);
+        init_endpoint(plain_client_);
 
         // TLS initialization for secure connection
         ws_client_.set_tls_init_handler([](connection_hdl) -> websocketpp::lib::shared_ptr<asio::ssl::context> {
@@ -74,20 +83,25 @@ namespace deribit {
         }
 
         try {
+            secure_ = config_.ws_url.compare(0, 6, "wss://") == 0;
             websocketpp::lib::error_code ec;
-            connection_ = ws_client_.get_connection(config_.WS_URL, ec);
+            with_endpoint([this, &ec](auto& endpoint) {
+                auto connection = endpoint.get_connection(config_.ws_url, ec);
+                if (!ec) {
+                    endpoint.connect(connection);
+                }
+            });
 
             if (ec) {
-                std::cout << "Error creating connection: " << ec.message() << std::endl;
+                std::cout << "Error creating connection to " << config_.ws_url << ": " << ec.message() << std::endl;
                 return;
             }
 
-            ws_client_.connect(connection_);
-
             // Start client thread
             client_thread_ = std::thread([this]() {
+                ThreadTopology::global().pin_current_thread(ThreadRole::Io, 0, "ws-io");
                 try {
-                    ws_client_.run();
+                    with_endpoint([](auto& endpoint) { endpoint.run(); });
                 } catch (std::exception& e) {
                     std::cout << "WebSocket client thread error: " << e.what() << std::endl;
                 }
@@ -108,6 +122,7 @@ namespace deribit {
 
         try {
             ws_client_.stop();
+            plain_client_.stop();
         } catch (std::exception& e) {
             std::cout << "Error stopping WebSocket client: " << e.what() << std::endl;
         }
@@ -126,6 +141,11 @@ namespace deribit {
         }
 
         try {
+            // The book must exist before the first update for it can arrive.
+            if (market_manager_) {
+                market_manager_->register_instrument(symbol);
+            }
+
             Json::Value sub;
             sub["jsonrpc"] = "2.0";
             sub["id"] = subscription_id_++;
@@ -136,7 +156,9 @@ namespace deribit {
             std::string message = writer.write(sub);
 
             websocketpp::lib::error_code ec;
-            ws_client_.send(connection_hdl_, message, websocketpp::frame::opcode::text, ec);
+            with_endpoint([this, &message, &ec](auto& endpoint) {
+                endpoint.send(connection_hdl_, message, websocketpp::frame::opcode::text, ec);
+            });
 
             if (ec) {
                 std::cout << "Error sending subscription: " << ec.message() << std::endl;
@@ -149,10 +171,51 @@ namespace deribit {
         }
     }
 
-    void DeribitClient::on_message(connection_hdl, client::message_ptr msg) {
+    void DeribitClient::start_recording(const std::string& path) {
+        std::lock_guard<std::mutex> lock(recorder_mutex_);
+        recorder_.open(path);
+        recording_.store(true, std::memory_order_relaxed);
+    }
+
+    size_t DeribitClient::stop_recording() {
+        std::lock_guard<std::mutex> lock(recorder_mutex_);
+        recording_.store(false, std::memory_order_relaxed);
+        recorder_.close();
+        return recorder_.frames();
+    }
+
+    void DeribitClient::on_message(connection_hdl, message_ptr msg) {
+        // Scratch for this frame (and, in RoutingMode::Inline, for applying it)
+        // comes from the IO thread's arena and is rewound on return.
+        ScratchArena::Scope scratch;
+        int64_t received = TscClock::now();
+        int64_t received_wall = wall_clock_ns();
         try {
             const std::string& payload = msg->get_payload();
 
+            if (recording_.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(recorder_mutex_);
+                if (recorder_.is_open()) {
+                    recorder_.record(FeedRecorder::now_ns(), payload);
+                }
+            }
+
+            // Book notifications are decoded straight out of the frame buffer,
+            // which is a recycled one from the connection's message pool.
+            if (book_decoder_.decode(payload, book_update_) == DecodeStatus::Book) {
+                book_update_.trace_id = ++next_trace_id_;
+                book_update_.receive_ticks = received;
+                EventTracer::record(TraceEvent::Received, book_update_.trace_id, book_update_.instrument_id, received);
+                if (market_manager_) {
+                    market_manager_->record_feed_timing(book_update_, received_wall);
+                    market_manager_->enqueue_orderbook_update(book_update_);
+                    EventTracer::record(TraceEvent::Enqueued, book_update_.trace_id, book_update_.instrument_id,
+                                        book_update_.enqueue_ticks);
+                }
+                return;
+            }
+
+            // Everything else (subscription acks, errors) is rare enough to go through the DOM.
             Json::Value json;
             Json::Reader reader;
             if (!reader.parse(payload, json)) {
@@ -166,25 +229,6 @@ namespace deribit {
                 return;
             }
 
-            if (json.isMember("params") && json["params"].isMember("channel")) {
-                const std::string& channel = json["params"]["channel"].asString();
-
-                if (channel.find("book.") == 0) {
-                    // Extract symbol from channel name: "book.BTC-PERPETUAL.100ms"
-                    size_t first_dot = channel.find('.');
-                    size_t second_dot = channel.find('.', first_dot + 1);
-
-                    if (first_dot != std::string::npos && second_dot != std::string::npos) {
-                        std::string symbol = channel.substr(first_dot + 1, second_dot - first_dot - 1);
-
-                        if (market_manager_) {
-                            // FIXED: Use std::move to avoid copying Json::Value
-                            market_manager_->enqueue_orderbook_update(symbol, std::move(json));
-                        }
-                    }
-                }
-            }
-
             if (json.isMember("error")) {
                 std::cout << "Deribit error: " << json["error"] << std::endl;
             }
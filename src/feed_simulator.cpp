@@ -0,0 +1,335 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#include "feed_simulator.hpp"
+#include "feed_latency.hpp"
+#include "tsc_clock.hpp"
+#include "wait_strategy.hpp"
+#include <asio/ssl/context.hpp>
+#include <json/json.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace deribit {
+
+    namespace {
+
+        // "book.BTC-PERPETUAL.100ms" (or book.<instrument>.<group>.<depth>.<interval>)
+        // -> "BTC-PERPETUAL"; empty for any other channel.
+        std::string book_instrument(const std::string& channel) {
+            if (channel.compare(0, 5, "book.") != 0) {
+                return {};
+            }
+            size_t end = channel.find('.', 5);
+            if (end == std::string::npos || end == 5) {
+                return {};
+            }
+            return channel.substr(5, end - 5);
+        }
+
+        // Overwrites the exchange "timestamp" (ms) in place. Only when the
+        // digit count matches, which it does for any date this century.
+        void restamp(std::string& payload, int64_t now_ms) {
+            static const std::string key = "\"timestamp\":";
+            size_t at = payload.find(key);
+            if (at == std::string::npos) {
+                return;
+            }
+            at += key.size();
+            size_t end = at;
+            while (end < payload.size() && std::isdigit(static_cast<unsigned char>(payload[end]))) {
+                ++end;
+            }
+            std::string digits = std::to_string(now_ms);
+            if (digits.size() == end - at) {
+                payload.replace(at, digits.size(), digits);
+            }
+        }
+
+        websocketpp::lib::shared_ptr<asio::ssl::context> make_tls_context(const FeedSimulatorOptions& options) {
+            auto ctx = websocketpp::lib::make_shared<asio::ssl::context>(asio::ssl::context::tlsv12_server);
+            ctx->set_options(asio::ssl::context::default_workarounds |
+                             asio::ssl::context::no_sslv2 |
+                             asio::ssl::context::no_sslv3 |
+                             asio::ssl::context::single_dh_use);
+            ctx->use_certificate_chain_file(options.cert_file);
+            ctx->use_private_key_file(options.key_file, asio::ssl::context::pem);
+            return ctx;
+        }
+
+        void wait_until(int64_t due) {
+            for (int64_t now = TscClock::now(); now < due; now = TscClock::now()) {
+                if (TscClock::to_ns(due - now) > 200000) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                } else {
+                    cpu_relax();
+                }
+            }
+        }
+    }
+
+    template<typename Server>
+    void FeedSimulator::init_server(Server& server) {
+        server.clear_access_channels(websocketpp::log::alevel::all);
+        server.clear_error_channels(websocketpp::log::elevel::all);
+        server.init_asio();
+        server.set_reuse_addr(true);
+
+        server.set_open_handler([this](connection_hdl hdl) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            subscribers_[hdl];
+        });
+
+        server.set_close_handler([this](connection_hdl hdl) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            subscribers_.erase(hdl);
+        });
+
+        server.set_message_handler([this, &server](connection_hdl hdl, typename Server::message_ptr msg) {
+            std::string reply = handle_request(hdl, msg->get_payload());
+            websocketpp::lib::error_code ec;
+            server.send(hdl, reply, websocketpp::frame::opcode::text, ec);
+        });
+    }
+
+    FeedSimulator::FeedSimulator(std::vector<RecordedFrame> frames, FeedSimulatorOptions options)
+        : frames_(std::move(frames)), options_(std::move(options)),
+          secure_(!options_.cert_file.empty() && !options_.key_file.empty()) {
+
+        // Only subscription notifications are streamed; a recording also holds acks.
+        instruments_.reserve(frames_.size());
+        for (const RecordedFrame& frame : frames_) {
+            bool notification = frame.payload.find("\"method\":\"subscription\"") != std::string::npos;
+            instruments_.push_back(notification ? instrument_of(frame.payload) : std::string());
+        }
+
+        init_server(plain_);
+        init_server(tls_);
+        tls_.set_tls_init_handler([this](connection_hdl) {
+            return make_tls_context(options_);
+        });
+    }
+
+    FeedSimulator::~FeedSimulator() {
+        stop();
+    }
+
+    void FeedSimulator::start() {
+        if (running_.exchange(true)) {
+            return;
+        }
+        try {
+            // A bad certificate or key fails here rather than on every handshake.
+            if (secure_) {
+                make_tls_context(options_);
+            }
+            with_server([this](auto& server) {
+                server.listen(websocketpp::lib::asio::ip::tcp::v4(), options_.port);
+                server.start_accept();
+                websocketpp::lib::asio::error_code ec;
+                port_ = server.get_local_endpoint(ec).port();
+            });
+        } catch (std::exception& e) {
+            running_ = false;
+            throw std::runtime_error(std::string("Feed simulator failed to listen: ") + e.what());
+        }
+
+        thread_ = std::thread([this]() {
+            try {
+                with_server([](auto& server) { server.run(); });
+            } catch (std::exception& e) {
+                std::cout << "Feed simulator thread error: " << e.what() << std::endl;
+            }
+        });
+        std::cout << "Feed simulator listening on " << url() << " (" << frames_.size() << " frames)" << std::endl;
+    }
+
+    void FeedSimulator::stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        with_server([this](auto& server) {
+            websocketpp::lib::error_code ec;
+            server.stop_listening(ec);
+            std::vector<connection_hdl> open;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& entry : subscribers_) {
+                    open.push_back(entry.first);
+                }
+            }
+            for (const connection_hdl& hdl : open) {
+                server.close(hdl, websocketpp::close::status::going_away, "simulator stopping", ec);
+            }
+            server.stop();
+        });
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    std::string FeedSimulator::url() const {
+        return std::string(secure_ ? "wss" : "ws") + "://127.0.0.1:" + std::to_string(port_) + "/ws/api/v2";
+    }
+
+    size_t FeedSimulator::subscriptions() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = 0;
+        for (const auto& entry : subscribers_) {
+            count += entry.second.size();
+        }
+        return count;
+    }
+
+    bool FeedSimulator::wait_for_subscriptions(size_t count, int64_t timeout_ms) const {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        while (subscriptions() < count) {
+            if (std::chrono::steady_clock::now() >= deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    std::string FeedSimulator::handle_request(connection_hdl hdl, const std::string& payload) {
+        Json::Value request;
+        Json::Value reply;
+        reply["jsonrpc"] = "2.0";
+
+        Json::CharReaderBuilder reader_builder;
+        std::string errs;
+        std::istringstream in(payload);
+        if (!Json::parseFromStream(reader_builder, in, &request, &errs) || !request.isObject()) {
+            reply["id"] = Json::nullValue;
+            reply["error"]["code"] = -32700;
+            reply["error"]["message"] = "Parse error";
+        } else {
+            reply["id"] = request["id"];
+            const std::string method = request["method"].asString();
+            if (method == "public/subscribe" || method == "private/subscribe" ||
+                method == "public/unsubscribe" || method == "private/unsubscribe") {
+                bool subscribe = method.find("unsubscribe") == std::string::npos;
+                Json::Value& result = reply["result"] = Json::Value(Json::arrayValue);
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = subscribers_.find(hdl);
+                for (const Json::Value& channel : request["params"]["channels"]) {
+                    // Only book channels are simulated; Deribit leaves out what it did not subscribe.
+                    std::string instrument = book_instrument(channel.asString());
+                    if (instrument.empty() || it == subscribers_.end()) {
+                        continue;
+                    }
+                    if (subscribe) {
+                        it->second.insert(instrument);
+                    } else {
+                        it->second.erase(instrument);
+                    }
+                    result.append(channel);
+                }
+            } else if (method == "public/test") {
+                reply["result"]["version"] = "feed_simulator";
+            } else if (method == "public/set_heartbeat" || method == "public/disable_heartbeat") {
+                reply["result"] = "ok";
+            } else {
+                reply["error"]["code"] = -32601;
+                reply["error"]["message"] = "Method not found";
+            }
+        }
+        reply["testnet"] = true;
+
+        Json::StreamWriterBuilder writer;
+        writer["indentation"] = "";
+        return Json::writeString(writer, reply);
+    }
+
+    template<typename Server>
+    StreamResult FeedSimulator::stream_on(Server& server, const StreamProfile& profile, const SendCallback& on_send) {
+        struct Target {
+            typename Server::connection_ptr connection;
+            std::unordered_set<std::string> instruments;
+            bool open;
+        };
+        std::vector<Target> targets;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& [hdl, instruments] : subscribers_) {
+                websocketpp::lib::error_code ec;
+                auto connection = server.get_con_from_hdl(hdl, ec);
+                if (!ec && !instruments.empty()) {
+                    targets.push_back({connection, instruments, true});
+                }
+            }
+        }
+
+        const size_t limit = profile.frames == 0 ? frames_.size() : profile.frames;
+        const size_t burst = std::max<size_t>(1, profile.burst);
+        const auto interval = profile.rate > 0
+            ? static_cast<int64_t>(static_cast<double>(burst) * 1e9 / profile.rate / TscClock::ns_per_tick())
+            : 0;
+
+        StreamResult result;
+        std::string restamped;
+        int64_t start = TscClock::now();
+        int64_t due = start;
+        for (size_t i = 0; i < frames_.size() && result.frames < limit; ++i) {
+            const std::string& instrument = instruments_[i];
+            if (instrument.empty()) {
+                continue;
+            }
+            if (interval > 0 && result.frames % burst == 0) {
+                wait_until(due);
+                due += interval;
+            }
+            ++result.frames;
+
+            const std::string* payload = &frames_[i].payload;
+            if (options_.restamp) {
+                restamped.assign(*payload);
+                restamp(restamped, wall_clock_ns() / 1000000);
+                payload = &restamped;
+            }
+
+            bool first = true;
+            for (Target& target : targets) {
+                if (!target.open || target.instruments.count(instrument) == 0) {
+                    continue;
+                }
+                // The socket is the bottleneck once the rate saturates it; wait
+                // for it instead of queueing without bound inside websocketpp.
+                if (target.connection->get_buffered_amount() > options_.max_buffered) {
+                    ++result.stalls;
+                    while (target.connection->get_buffered_amount() > options_.max_buffered &&
+                           target.connection->get_state() == websocketpp::session::state::open) {
+                        std::this_thread::yield();
+                    }
+                }
+                if (first && on_send) {
+                    on_send(i, TscClock::now());
+                    first = false;
+                }
+                websocketpp::lib::error_code ec = target.connection->send(*payload, websocketpp::frame::opcode::text);
+                if (ec) {
+                    ++result.send_errors;
+                    target.open = false;
+                } else {
+                    ++result.sent;
+                }
+            }
+        }
+        result.elapsed_ns = TscClock::to_ns(TscClock::now() - start);
+        return result;
+    }
+
+    StreamResult FeedSimulator::stream(const StreamProfile& profile, const SendCallback& on_send) {
+        StreamResult result;
+        with_server([&](auto& server) {
+            result = stream_on(server, profile, on_send);
+        });
+        return result;
+    }
+}
@@ -6,293 +6,659 @@
 #include <iostream>
 namespace deribit {
 
-    // FIXED: Race condition bug - now properly handles mutex lifecycle
-    std::mutex &MarketData::get_mutex_for_symbol(const std::string &symbol) {
-        std::lock_guard<std::mutex> mtx(mutexes_map_mutex_);
-        if (orderbook_mutexes_.find(symbol) == orderbook_mutexes_.end()) {
-            orderbook_mutexes_[symbol] = std::make_unique<std::mutex>();
+    namespace {
+        template<typename Ladder>
+        void apply_levels(Ladder& ladder, const std::vector<BookLevel>& levels) {
+            for (const BookLevel& level : levels) {
+                if (level.action == LevelAction::Delete) {
+                    ladder.erase(level.price);
+                } else {
+                    ladder.set(level.price, level.amount);
+                }
+            }
         }
-        return *orderbook_mutexes_[symbol];
     }
 
-    // FIXED: Race condition - acquire map mutex first, then symbol mutex
-    Orderbook MarketData::get_orderbook(const std::string &symbol) {
-        // Step 1: Get or create the mutex for this symbol (holds mutexes_map_mutex_ briefly)
-        std::mutex* symbol_mutex = nullptr;
-        {
-            std::lock_guard<std::mutex> map_lock(mutexes_map_mutex_);
-            if (orderbook_mutexes_.find(symbol) == orderbook_mutexes_.end()) {
-                orderbook_mutexes_[symbol] = std::make_unique<std::mutex>();
-            }
-            symbol_mutex = orderbook_mutexes_[symbol].get();
+    InstrumentId MarketData::register_instrument(const std::string& symbol) {
+        std::lock_guard<std::mutex> lock(register_mutex_);
+
+        InstrumentId id = instruments_.intern(symbol);
+        if (!books_[id].load(std::memory_order_relaxed)) {
+            size_t shard = shards_.empty() ? 0 : std::hash<std::string>{}(symbol) % shards_.size();
+            BookSlot* slot = create_slot(shard);
+            slot->id = id;
+            slot->book.instrument_name = symbol;
+            slot->shard.store(static_cast<uint32_t>(shard), std::memory_order_relaxed);
+            books_[id].store(slot, std::memory_order_release);
         }
+        return id;
+    }
 
-        // Step 2: Now lock the symbol-specific mutex (mutexes_map_mutex_ already released)
-        std::lock_guard<std::mutex> symbol_lock(*symbol_mutex);
+    // In sharded mode the book is allocated by the worker that will own it, so
+    // its ladders land on that worker's NUMA node (first touch) and its later
+    // allocations come from that thread's malloc arena. assign_shard() moves
+    // the symbol but not the memory.
+    MarketData::BookSlot* MarketData::create_slot(size_t shard) {
+        if (shards_.empty() || !ThreadTopology::global().threading().numa_local_memory) {
+            return new_slot();
+        }
 
-        // Step 3: Access the orderbook
-        auto it = orderbooks_.find(symbol);
-        return (it != orderbooks_.end()) ? it->second : Orderbook();
+        std::promise<BookSlot*> created;
+        std::future<BookSlot*> result = created.get_future();
+        post_to_shard(*shards_[shard], [this, &created] { created.set_value(new_slot()); });
+        return result.get();
     }
 
-    void MarketData::on_orderbook_update(const std::string& symbol, const Json::Value& payload) {
-        if (!payload.isMember("params") || !payload["params"].isMember("data")) return;
+    // After prepare_memory(), a new book also gets its conflation storage up
+    // front: the merged update the worker copies out, and enough map nodes in
+    // the conflation pool for `levels` per side, so the first burst to
+    // conflate this instrument does not allocate on the feed thread or worker.
+    MarketData::BookSlot* MarketData::new_slot() const {
+        auto* slot = new BookSlot();
+        size_t levels = reserve_levels_.load(std::memory_order_relaxed);
+        if (levels == 0) {
+            return slot;
+        }
 
-        const Json::Value& data = payload["params"]["data"];
-        int64_t update_ts = data.isMember("timestamp") ? data["timestamp"].asInt64() : 0;
+        slot->conflated.bids.reserve(levels);
+        slot->conflated.asks.reserve(levels);
+        Conflation& c = slot->conflation;
+        for (size_t i = 0; i < levels; ++i) {
+            c.bids.emplace(static_cast<double>(i), BookLevel{});
+            c.asks.emplace(static_cast<double>(i), BookLevel{});
+        }
+        c.bids.clear();
+        c.asks.clear();
+        return slot;
+    }
 
-        // Get the symbol-specific mutex using the fixed method
-        std::mutex* symbol_mutex = nullptr;
+    // Runs `call` on the shard's worker, between batches.
+    void MarketData::post_to_shard(Shard& shard, std::function<void()> call) {
         {
-            std::lock_guard<std::mutex> map_lock(mutexes_map_mutex_);
-            if (orderbook_mutexes_.find(symbol) == orderbook_mutexes_.end()) {
-                orderbook_mutexes_[symbol] = std::make_unique<std::mutex>();
+            std::lock_guard<std::mutex> lock(shard.inbox.mutex);
+            shard.inbox.calls.push_back(std::move(call));
+            shard.inbox.pending.store(true, std::memory_order_release);
+        }
+        shard.wait.notify();
+    }
+
+    namespace {
+        // The ring was fully written when it was built, so it is already
+        // faulted in; reserving touches every slot again. Consumers only read
+        // a slot's sequence until something is pushed into it.
+        template<typename Queue>
+        void prepare_queue(Queue& queue, bool huge_pages, size_t levels) {
+            if (huge_pages) {
+                advise_huge_pages(queue.storage(), queue.storage_bytes());
             }
-            symbol_mutex = orderbook_mutexes_[symbol].get();
+            queue.for_each_element([levels](BookUpdate& update) {
+                update.bids.reserve(levels);
+                update.asks.reserve(levels);
+            });
         }
+    }
 
-        std::lock_guard<std::mutex> symbol_lock(*symbol_mutex);
+    void MarketData::prepare_memory(bool huge_pages, size_t levels) {
+        reserve_levels_.store(levels, std::memory_order_relaxed);
+        if (routing_mode_ != RoutingMode::Sharded) {
+            prepare_queue(queue_, huge_pages, levels);
+            return;
+        }
 
-        auto& ob = orderbooks_[symbol];
+        std::vector<std::promise<void>> done(shards_.size());
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            Shard& shard = *shards_[i];
+            std::promise<void>* finished = &done[i];
+            post_to_shard(shard, [&shard, finished, huge_pages, levels] {
+                prepare_queue(shard.queue, huge_pages, levels);
+                ScratchArena::local().prefault();
+                finished->set_value();
+            });
+        }
+        for (auto& finished : done) {
+            finished.get_future().get();
+        }
+    }
 
-        if (update_ts <= ob.timestamp) {
-            return;
+    bool MarketData::get_top_of_book(const std::string& symbol, TopOfBook& out) {
+        BookSlot* slot = slot_for(instruments_.find(symbol));
+        if (!slot || slot->top.version() == 0) {
+            return false;
         }
+        out = slot->top.load();
+        return true;
+    }
+
+    bool MarketData::get_depth(const std::string& symbol, DepthSnapshot& out) {
+        return read_depth(symbol, [&out](const DepthSnapshot& snapshot) {
+            out = snapshot;
+        });
+    }
+
+    Orderbook MarketData::get_orderbook(const std::string &symbol) {
+        Orderbook ob;
+        read_depth(symbol, [&](const DepthSnapshot& snapshot) {
+            ob.instrument_name = symbol;
+            ob.timestamp = snapshot.timestamp;
+            ob.change_id = snapshot.change_id;
+            ob.stale = snapshot.stale;
+            ob.bids.set_tick_size(snapshot.tick_size);
+            ob.asks.set_tick_size(snapshot.tick_size);
+            for (size_t i = 0; i < snapshot.bid_count; ++i) {
+                ob.bids.set(snapshot.bids[i].price, snapshot.bids[i].amount);
+            }
+            for (size_t i = 0; i < snapshot.ask_count; ++i) {
+                ob.asks.set(snapshot.asks[i].price, snapshot.asks[i].amount);
+            }
+        });
+        refresh_best_levels(ob);
+        return ob;
+    }
+
+    void MarketData::restart_stats() {
+        total_updates_.store(0, std::memory_order_relaxed);
+        total_processing_ticks_.store(0, std::memory_order_relaxed);
+        total_batches_.store(0, std::memory_order_relaxed);
+        dropped_messages_.store(0, std::memory_order_relaxed);
+        conflated_messages_.store(0, std::memory_order_relaxed);
+        max_conflation_depth_.store(0, std::memory_order_relaxed);
+        gaps_detected_.store(0, std::memory_order_relaxed);
+        resyncs_completed_.store(0, std::memory_order_relaxed);
+        latency_.set_baseline();
+    }
 
-        if (data.isMember("type")) {
-            std::string type = data["type"].asString();
-            if (type == "snapshot") {
-                parse_orderbook_update(symbol, data);
-            } else if (type == "change") {
-                apply_incremental_update(ob, data);
+    void MarketData::print_gaps(std::ostream& out) const {
+        size_t count = instruments_.size();
+        for (size_t id = 0; id < count; ++id) {
+            BookSlot* slot = slot_for(static_cast<InstrumentId>(id));
+            if (!slot || !slot->reported.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            size_t gaps = slot->gaps.load(std::memory_order_relaxed);
+            if (gaps > 0) {
+                out << "  " << instruments_.name(static_cast<InstrumentId>(id)) << ": " << gaps << " gaps"
+                    << (slot->top.load().stale ? " (stale, resyncing)" : "") << '\n';
             }
         }
     }
 
-    void MarketData::parse_orderbook_update(const std::string &symbol, const Json::Value &json_data) {
-        const Json::Value* data_ptr;
-        if (json_data.isMember("params")) {
-            data_ptr = &json_data["params"]["data"];
+    void MarketData::print_feed_latency(std::ostream& out) const {
+        out << "Feed delay (local receive - exchange timestamp) and jitter, per instrument:" << std::endl;
+        out << std::left << std::setw(22) << "Instrument" << std::right << std::setw(9) << "Msgs";
+        for (const char* column : {"p50", "p99", "p99.9", "Max", "Jit p50", "Jit p99", "Jit max"}) {
+            out << std::setw(10) << column;
+        }
+        out << std::endl;
+
+        size_t shown = 0;
+        uint64_t ahead = 0;
+        for_each_feed_timing([&](const std::string& name, const FeedTiming& timing) {
+            HistogramSnapshot delay = timing.delay().snapshot();
+            HistogramSnapshot jitter = timing.jitter().snapshot();
+            out << std::left << std::setw(22) << name << std::right << std::setw(9) << delay.count();
+            for (uint64_t ns : {delay.percentile(50.0), delay.percentile(99.0), delay.percentile(99.9), delay.max(),
+                                jitter.percentile(50.0), jitter.percentile(99.0), jitter.max()}) {
+                out << std::setw(10) << LatencyTracker::format_latency(ns);
+            }
+            out << std::endl;
+            ahead += timing.ahead_of_local_clock();
+            ++shown;
+        });
+        if (shown == 0) {
+            out << "  (no exchange messages yet)" << std::endl;
+        }
+        if (ahead > 0) {
+            out << "  " << ahead << " messages were stamped after our receive time; check NTP" << std::endl;
+        }
+    }
+
+    std::vector<QueueMetrics> MarketData::queue_metrics() const {
+        std::vector<QueueMetrics> out;
+        if (routing_mode_ == RoutingMode::Sharded) {
+            for (const auto& shard : shards_) {
+                out.push_back({shard->queue.size(), shard->high_water.load(std::memory_order_relaxed),
+                               shard->queue.capacity()});
+            }
+        } else if (routing_mode_ == RoutingMode::Shared) {
+            out.push_back({queue_.size(), shared_high_water_.load(std::memory_order_relaxed), queue_.capacity()});
+        }
+        return out;
+    }
+
+    void MarketData::on_orderbook_update(const BookUpdate& update) {
+        BookSlot* slot = slot_for(update.instrument_id);
+        if (!slot) {
+            return;
+        }
+
+        if (routing_mode_ == RoutingMode::Shared) {
+            std::lock_guard<std::mutex> write_lock(slot->write_mutex);
+            apply_update(*slot, update);
         } else {
-            data_ptr = &json_data;
-        }
-        const Json::Value& data = *data_ptr;
-
-        auto& ob = orderbooks_[symbol];
-
-        ob.instrument_name = symbol;
-        ob.timestamp = data.get("timestamp", ob.timestamp).asInt64();
-        ob.change_id = data.get("change_id", ob.change_id).asInt64();
-
-        if (const Json::Value& val = data["best_bid_price"]; !val.isNull()) {
-            ob.best_bid_price = val.asDouble();
-        }
-        if (const Json::Value& val = data["best_bid_amount"]; !val.isNull()) {
-            ob.best_bid_amount = val.asDouble();
-        }
-        if (const Json::Value& val = data["best_ask_price"]; !val.isNull()) {
-            ob.best_ask_price = val.asDouble();
-        }
-        if (const Json::Value& val = data["best_ask_amount"]; !val.isNull()) {
-            ob.best_ask_amount = val.asDouble();
-        }
-
-        if (const Json::Value& bids = data["bids"]; bids.isArray()) {
-            for (Json::ArrayIndex i = 0; i < bids.size(); ++i) {
-                const Json::Value& bid = bids[i];
-                if (bid.size() >= 2) {
-                    try {
-                        if (bid.size() >= 3 && bid[0].isString()) {
-                            if (bid[0].asString() == "delete") {
-                                double price = bid[1].asDouble();
-                                ob.bids.erase(price);
-                            } else {
-                                double price = bid[1].asDouble();
-                                double amount = bid[2].asDouble();
-                                if (amount == 0.0) {
-                                    ob.bids.erase(price);
-                                } else {
-                                    ob.bids[price] = amount;
-                                }
-                            }
-                        } else {
-                            double price = bid[0].asDouble();
-                            double amount = bid[1].asDouble();
-                            if (amount == 0.0) {
-                                ob.bids.erase(price);
-                            } else {
-                                ob.bids[price] = amount;
-                            }
-                        }
-                    } catch (const std::exception& e) {
-                        std::cerr << "Error processing bid: " << e.what() << std::endl;
-                        continue;
-                    }
+            apply_update(*slot, update);
+        }
+    }
+
+    namespace {
+        // Folds `levels` into the net per-price set. On top of a snapshot a
+        // delete simply removes the level; on top of changes it has to be kept
+        // so the worker deletes it from the book.
+        void merge_levels(std::pmr::map<double, BookLevel>& net, const std::vector<BookLevel>& levels,
+                          bool onto_snapshot) {
+            for (const BookLevel& level : levels) {
+                if (level.action == LevelAction::Delete && onto_snapshot) {
+                    net.erase(level.price);
+                } else {
+                    net[level.price] = level;
                 }
             }
         }
-        if (const Json::Value& asks = data["asks"]; asks.isArray()) {
-            for (Json::ArrayIndex i = 0; i < asks.size(); ++i) {
-                const Json::Value& ask = asks[i];
-                if (ask.size() >= 2) {
-                    try {
-                        if (ask.size() >= 3 && ask[0].isString()) {
-                            if (ask[0].asString() == "delete") {
-                                double price = ask[1].asDouble();
-                                ob.asks.erase(price);
-                            } else {
-                                double price = ask[1].asDouble();
-                                double amount = ask[2].asDouble();
-                                if (amount == 0.0) {
-                                    ob.asks.erase(price);
-                                } else {
-                                    ob.asks[price] = amount;
-                                }
-                            }
-                        } else {
-                            double price = ask[0].asDouble();
-                            double amount = ask[1].asDouble();
-                            if (amount == 0.0) {
-                                ob.asks.erase(price);
-                            } else {
-                                ob.asks[price] = amount;
-                            }
-                        }
-                    } catch (const std::exception& e) {
-                        std::cerr << "Error processing ask: " << e.what() << std::endl;
-                        continue;
-                    }
-                }
+
+        void copy_levels(const std::pmr::map<double, BookLevel>& net, std::vector<BookLevel>& out) {
+            out.clear();
+            for (const auto& entry : net) {
+                out.push_back(entry.second);
             }
         }
+    }
 
-        if (!ob.bids.empty()) {
-            ob.best_bid_price = ob.bids.rbegin()->first;
-            ob.best_bid_amount = ob.bids.rbegin()->second;
-        } else {
-            ob.best_bid_price = 0.0;
-            ob.best_bid_amount = 0.0;
+    // Feed thread, instrument already conflating. False if the worker took the
+    // merged update in the meantime, in which case the caller queues normally.
+    bool MarketData::conflate(BookSlot& slot, const BookUpdate& update) {
+        Conflation& c = slot.conflation;
+        std::lock_guard<std::mutex> lock(c.mutex);
+        if (!c.active.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        merge_conflated(c, update);
+        return true;
+    }
+
+    // Under c.mutex.
+    void MarketData::merge_conflated(Conflation& c, const BookUpdate& update) {
+        if (update.type == BookUpdateType::Snapshot) {
+            c.type = BookUpdateType::Snapshot;
+            c.prev_change_id = 0;
+            c.bids.clear();
+            c.asks.clear();
+        } else if (update.prev_change_id != 0 && c.change_id != 0 && update.prev_change_id != c.change_id) {
+            // A gap inside the burst. Merging across it would hide it from the
+            // worker, so start over from here and let the gap surface on apply.
+            c.type = BookUpdateType::Change;
+            c.prev_change_id = update.prev_change_id;
+            c.bids.clear();
+            c.asks.clear();
+        }
+
+        bool onto_snapshot = (c.type == BookUpdateType::Snapshot);
+        merge_levels(c.bids, update.bids, onto_snapshot);
+        merge_levels(c.asks, update.asks, onto_snapshot);
+        c.timestamp = update.timestamp;
+        c.change_id = update.change_id;
+        ++c.depth;
+
+        conflated_messages_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Feed thread, worker queue just rejected `update`. The update is merged in
+    // the same critical section that activates conflation, so an idle worker's
+    // flush can never take an empty set.
+    void MarketData::begin_conflation(BookSlot& slot, const BookUpdate& update) {
+        Conflation& c = slot.conflation;
+        {
+            std::lock_guard<std::mutex> lock(c.mutex);
+            c.type = update.type;
+            c.prev_change_id = update.prev_change_id;
+            c.trace_id = update.trace_id;
+            c.receive_ticks = update.receive_ticks;
+            c.enqueue_ticks = update.enqueue_ticks;
+            c.timestamp = 0;
+            c.change_id = 0;
+            c.depth = 0;
+            c.bids.clear();
+            c.asks.clear();
+            merge_conflated(c, update);
+
+            c.marker_queued = false;
+            c.unmarked = &unmarked_conflations(slot);
+            c.unmarked->fetch_add(1, std::memory_order_relaxed);
+            ++c.generation;
+            c.active.store(true, std::memory_order_release);
+        }
+
+        if (!queue_conflation_marker(slot)) {
+            pending_markers_.push_back(&slot);
         }
+    }
+
+    // Under c.mutex, once the update has a marker queued or has been taken.
+    void MarketData::clear_unmarked(Conflation& c) {
+        if (c.unmarked) {
+            c.unmarked->fetch_sub(1, std::memory_order_relaxed);
+            c.unmarked = nullptr;
+        }
+    }
 
-        if (!ob.asks.empty()) {
-            ob.best_ask_price = ob.asks.begin()->first;
-            ob.best_ask_amount = ob.asks.begin()->second;
+    // The marker tells the worker to take the merged update. It goes through the
+    // same queue as everything else, so it is applied after every message that
+    // was queued for the instrument before conflation started.
+    bool MarketData::queue_conflation_marker(BookSlot& slot) {
+        Conflation& c = slot.conflation;
+        std::lock_guard<std::mutex> lock(c.mutex);
+        if (!c.active.load(std::memory_order_relaxed) || c.marker_queued) {
+            return true;    // already taken, or nothing left to do
+        }
+
+        BookUpdate marker;
+        marker.instrument_id = slot.id;
+        marker.type = BookUpdateType::Conflated;
+        marker.conflation_generation = c.generation;
+        c.marker_queued = push_to_worker(slot, marker);
+        if (c.marker_queued) {
+            clear_unmarked(c);
+        }
+        return c.marker_queued;
+    }
+
+    void MarketData::retry_conflation_markers() {
+        size_t kept = 0;
+        for (BookSlot* slot : pending_markers_) {
+            if (!queue_conflation_marker(*slot)) {
+                pending_markers_[kept++] = slot;
+            }
+        }
+        pending_markers_.resize(kept);
+    }
+
+    // Worker side. With a generation, only the update that marker was queued
+    // for is taken. Without one (idle flush), only an update whose marker never
+    // made it into the queue, and only if the queue is empty: conflation began
+    // after its last message for the instrument was queued, so an empty queue
+    // seen under the lock means those have all been popped.
+    bool MarketData::take_conflated(BookSlot& slot, const uint32_t* generation) {
+        Conflation& c = slot.conflation;
+        std::lock_guard<std::mutex> lock(c.mutex);
+        if (!c.active.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (generation) {
+            if (*generation != c.generation) {
+                return false;
+            }
         } else {
-            ob.best_ask_price = 0.0;
-            ob.best_ask_amount = 0.0;
-        }
-
-        std::cout << "Snapshot processed for " << symbol << std::endl;
-    }
-
-    void MarketData::apply_incremental_update(Orderbook& ob, const Json::Value& update_data) {
-        ob.timestamp = update_data.get("timestamp", ob.timestamp).asInt64();
-        ob.change_id = update_data.get("change_id", ob.change_id).asInt64();
-
-        if (const Json::Value& bids = update_data["bids"]; bids.isArray()) {
-            for (Json::ArrayIndex i = 0; i < bids.size(); ++i) {
-                const Json::Value& b = bids[i];
-                if (b.size() >= 2) {
-                    try {
-                        if (b.size() >= 3 && b[0].isString()) {
-                            if (b[0].asString() == "delete") {
-                                double price = b[1].asDouble();
-                                ob.bids.erase(price);
-                            } else {
-                                double price = b[1].asDouble();
-                                double amount = b[2].asDouble();
-                                if (amount == 0.0) {
-                                    ob.bids.erase(price);
-                                } else {
-                                    ob.bids[price] = amount;
-                                }
-                            }
-                        } else {
-                            double price = b[0].asDouble();
-                            double amount = b[1].asDouble();
-                            if (amount == 0.0) {
-                                ob.bids.erase(price);
-                            } else {
-                                ob.bids[price] = amount;
-                            }
-                        }
-                    } catch (const std::exception& e) {
-                        std::cerr << "Error processing bid update: " << e.what() << std::endl;
-                        continue;
-                    }
+            bool drained = (routing_mode_ == RoutingMode::Sharded)
+                ? shards_[slot.shard.load(std::memory_order_relaxed)]->queue.empty()
+                : queue_.empty();
+            if (c.marker_queued || !drained) {
+                return false;
+            }
+        }
+
+        BookUpdate& out = slot.conflated;
+        out.clear();
+        out.instrument_id = slot.id;
+        out.type = c.type;
+        out.timestamp = c.timestamp;
+        out.change_id = c.change_id;
+        out.prev_change_id = c.prev_change_id;
+        out.trace_id = c.trace_id;
+        out.receive_ticks = c.receive_ticks;
+        out.enqueue_ticks = c.enqueue_ticks;
+        copy_levels(c.bids, out.bids);
+        copy_levels(c.asks, out.asks);
+
+        size_t depth = c.depth;
+        size_t max_depth = max_conflation_depth_.load(std::memory_order_relaxed);
+        while (depth > max_depth &&
+               !max_conflation_depth_.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+        }
+
+        clear_unmarked(c);
+        c.active.store(false, std::memory_order_release);
+        return true;
+    }
+
+    // Called by an idle worker, only while it has a conflated update whose
+    // marker never made it into its queue, so that the update does not wait
+    // for the next feed message. In sharded mode a worker only flushes the
+    // instruments it owns; shared mode has a single worker. True if anything
+    // was applied.
+    bool MarketData::flush_conflation(Shard* shard) {
+        bool took = false;
+        size_t count = instruments_.size();
+        for (size_t id = 0; id < count; ++id) {
+            BookSlot* slot = slot_for(static_cast<InstrumentId>(id));
+            if (!slot || !slot->conflation.active.load(std::memory_order_acquire)) {
+                continue;
+            }
+            if (shard && slot->shard.load(std::memory_order_relaxed) != shard->index) {
+                continue;
+            }
+            if (routing_mode_ == RoutingMode::Shared) {
+                std::lock_guard<std::mutex> write_lock(slot->write_mutex);
+                if (take_conflated(*slot, nullptr)) {
+                    apply_update(*slot, slot->conflated);
+                    took = true;
                 }
+            } else if (take_conflated(*slot, nullptr)) {
+                apply_update(*slot, slot->conflated);
+                took = true;
             }
         }
-        if (const Json::Value& asks = update_data["asks"]; asks.isArray()) {
-            for (Json::ArrayIndex i = 0; i < asks.size(); ++i) {
-                const Json::Value& a = asks[i];
-                if (a.size() >= 2) {
-                    try {
-                        if (a.size() >= 3 && a[0].isString()) {
-                            if (a[0].asString() == "delete") {
-                                double price = a[1].asDouble();
-                                ob.asks.erase(price);
-                            } else {
-                                double price = a[1].asDouble();
-                                double amount = a[2].asDouble();
-                                if (amount == 0.0) {
-                                    ob.asks.erase(price);
-                                } else {
-                                    ob.asks[price] = amount;
-                                }
-                            }
-                        } else {
-                            double price = a[0].asDouble();
-                            double amount = a[1].asDouble();
-                            if (amount == 0.0) {
-                                ob.asks.erase(price);
-                            } else {
-                                ob.asks[price] = amount;
-                            }
-                        }
-                    } catch (const std::exception& e) {
-                        std::cerr << "Error processing ask update: " << e.what() << std::endl;
-                        continue;
-                    }
+        return took;
+    }
+
+    namespace {
+        // Deribit chains every change to the previous one through prev_change_id.
+        bool breaks_sequence(const Orderbook& ob, const BookUpdate& update) {
+            return ob.change_id != 0 && update.prev_change_id != 0 &&
+                   update.prev_change_id != ob.change_id;
+        }
+    }
+
+    void MarketData::apply_update(BookSlot& slot, const BookUpdate& update) {
+        Orderbook& ob = slot.book;
+        ScratchArena::Scope scratch;    // rewound when this message is done
+
+        if (update.type == BookUpdateType::Conflated) {
+            if (take_conflated(slot, &update.conflation_generation)) {
+                // Timed from the oldest message merged into it, not the marker.
+                if (StageRecorder* stages = current_stages_) {
+                    stages->current.receive_ticks = slot.conflated.receive_ticks;
+                    stages->current.enqueue_ticks = slot.conflated.enqueue_ticks;
                 }
+                apply_update(slot, slot.conflated);
             }
+            return;
         }
-        bool has_json_best_bid = false, has_json_best_ask = false;
 
-        if (const Json::Value& val = update_data["best_bid_price"]; !val.isNull()) {
-            ob.best_bid_price = val.asDouble();
-            has_json_best_bid = true;
+        // What the strategy callback reports as the cause of anything it sends.
+        ob.trace = TraceContext{update.trace_id, update.receive_ticks, 0};
+
+        if (update.type == BookUpdateType::Snapshot) {
+            // Two resync requests can cross; the later answer must not roll
+            // back a book that has already moved past it.
+            if (!ob.stale && update.change_id != 0 && update.change_id <= ob.change_id) {
+                return;
+            }
+            parse_orderbook_update(ob, update);
+            std::cout << "Snapshot processed for " << ob.instrument_name << std::endl;
+            if (ob.stale) {
+                replay_pending(slot);
+            }
+            publish(slot);
+            return;
         }
-        if (const Json::Value& val = update_data["best_ask_price"]; !val.isNull()) {
-            ob.best_ask_price = val.asDouble();
-            has_json_best_ask = true;
+
+        if (ob.stale) {
+            buffer_delta(slot, update);
+            return;
         }
-        if (const Json::Value& val = update_data["best_bid_amount"]; !val.isNull()) {
-            ob.best_bid_amount = val.asDouble();
+
+        // change_id is strictly increasing per instrument, unlike timestamps,
+        // which repeat within a millisecond. Only fall back to the timestamp
+        // if the feed did not give us a change_id.
+        bool already_applied = update.change_id != 0
+            ? update.change_id <= ob.change_id
+            : update.timestamp <= ob.timestamp;
+        if (already_applied) {
+            return;
         }
-        if (const Json::Value& val = update_data["best_ask_amount"]; !val.isNull()) {
-            ob.best_ask_amount = val.asDouble();
+
+        if (breaks_sequence(ob, update)) {
+            start_resync(slot, update);
+            return;
         }
 
-        if (!has_json_best_bid) {
-            if (!ob.bids.empty()) {
-                ob.best_bid_price = ob.bids.rbegin()->first;
-                ob.best_bid_amount = ob.bids.rbegin()->second;
-            } else {
-                ob.best_bid_price = 0.0;
-                ob.best_bid_amount = 0.0;
-            }
+        apply_incremental_update(ob, update);
+        publish(slot);
+    }
+
+    // A message was lost: stop applying, keep the deltas, and ask for a snapshot.
+    // The last good state stays published, flagged stale.
+    void MarketData::start_resync(BookSlot& slot, const BookUpdate& update) {
+        // Counted, not logged: this runs on the worker, possibly once per
+        // message during a burst. print_latency_stats() reports them.
+        gaps_detected_.fetch_add(1, std::memory_order_relaxed);
+        slot.gaps.fetch_add(1, std::memory_order_relaxed);
+
+        slot.book.stale = true;
+        slot.pending_deltas.clear();
+        slot.pending_deltas.push_back(update);
+        publish(slot);
+        request_resync(slot);
+    }
+
+    void MarketData::buffer_delta(BookSlot& slot, const BookUpdate& update) {
+        auto& pending = slot.pending_deltas;
+        if (pending.size() >= kMaxPendingDeltas) {
+            pending.erase(pending.begin(), pending.begin() + pending.size() / 2);
         }
+        pending.push_back(update);
 
-        if (!has_json_best_ask) {
-            if (!ob.asks.empty()) {
-                ob.best_ask_price = ob.asks.begin()->first;
-                ob.best_ask_amount = ob.asks.begin()->second;
-            } else {
-                ob.best_ask_price = 0.0;
-                ob.best_ask_amount = 0.0;
+        if (std::chrono::steady_clock::now() - slot.resync_requested_at > kResyncRetryAfter) {
+            request_resync(slot);
+        }
+    }
+
+    // Called with a fresh snapshot applied: replay whatever continues from it.
+    void MarketData::replay_pending(BookSlot& slot) {
+        Orderbook& ob = slot.book;
+        auto& pending = slot.pending_deltas;
+
+        size_t i = 0;
+        for (; i < pending.size(); ++i) {
+            const BookUpdate& delta = pending[i];
+            if (delta.change_id <= ob.change_id) {
+                continue;       // already covered by the snapshot
+            }
+            if (breaks_sequence(ob, delta)) {
+                break;
             }
+            apply_incremental_update(ob, delta);
+        }
+
+        if (i < pending.size()) {
+            // The snapshot predates the gap (or the buffer itself has a hole):
+            // keep what is left and try again with a newer snapshot.
+            pending.erase(pending.begin(), pending.begin() + i);
+            request_resync(slot);
+            return;
+        }
+
+        pending.clear();
+        ob.stale = false;
+        resyncs_completed_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void MarketData::request_resync(BookSlot& slot) {
+        slot.resync_requested_at = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(resync_mutex_);
+        if (resync_handler_) {
+            resync_handler_(slot.id, slot.book.instrument_name);
+        }
+    }
+
+    void MarketData::publish(BookSlot& slot) {
+        const Orderbook& ob = slot.book;
+
+        TopOfBook top;
+        top.timestamp = ob.timestamp;
+        top.change_id = ob.change_id;
+        top.best_bid_price = ob.best_bid_price;
+        top.best_bid_amount = ob.best_bid_amount;
+        top.best_ask_price = ob.best_ask_price;
+        top.best_ask_amount = ob.best_ask_amount;
+        top.stale = ob.stale;
+        slot.top.store(top);
+
+        DepthSnapshot* snapshot = slot.depth.acquire();
+        snapshot->timestamp = ob.timestamp;
+        snapshot->change_id = ob.change_id;
+        snapshot->tick_size = ob.bids.tick_size();
+        snapshot->stale = ob.stale;
+        snapshot->bid_count = 0;
+        snapshot->ask_count = 0;
+        ob.bids.for_each_level(DepthSnapshot::kMaxLevels, [snapshot](double price, double amount) {
+            snapshot->bids[snapshot->bid_count++] = {price, amount};
+        });
+        ob.asks.for_each_level(DepthSnapshot::kMaxLevels, [snapshot](double price, double amount) {
+            snapshot->asks[snapshot->ask_count++] = {price, amount};
+        });
+        slot.depth.publish(snapshot);
+
+        StageRecorder* stages = current_stages_;
+        if (stages) {
+            stages->current.callback_start_ticks = TscClock::now();
         }
+        if (update_callback_) {
+            update_callback_(ob.instrument_name, ob);
+        }
+        if (stages) {
+            stages->current.callback_end_ticks = TscClock::now();
+        }
+    }
+
+    void MarketData::parse_orderbook_update(Orderbook& ob, const BookUpdate& update) {
+        ob.timestamp = update.timestamp;
+        ob.change_id = update.change_id;
+
+        // A snapshot replaces the book. Re-derive the tick grid from it so the
+        // ladder window lines up with the instrument's real tick size.
+        ScratchArena::Scope scratch;
+        std::pmr::vector<double> prices(scratch.resource());
+        prices.reserve(update.bids.size() + update.asks.size());
+        for (const BookLevel& level : update.bids) prices.push_back(level.price);
+        for (const BookLevel& level : update.asks) prices.push_back(level.price);
+        double tick = BidLadder::infer_tick_size(prices.begin(), prices.end(), ob.bids.tick_size());
+        ob.bids.set_tick_size(tick);
+        ob.asks.set_tick_size(tick);
+
+        apply_levels(ob.bids, update.bids);
+        apply_levels(ob.asks, update.asks);
+
+        refresh_best_levels(ob);
+    }
+
+    void MarketData::apply_incremental_update(Orderbook& ob, const BookUpdate& update) {
+        ob.timestamp = update.timestamp;
+        ob.change_id = update.change_id;
+
+        apply_levels(ob.bids, update.bids);
+        apply_levels(ob.asks, update.asks);
+
+        refresh_best_levels(ob);
+    }
+
+    // The ladders track their own touch, so this is O(1) per side.
+    void MarketData::refresh_best_levels(Orderbook& ob) {
+        auto [bid_price, bid_amount] = ob.bids.best_level();
+        ob.best_bid_price = bid_price;
+        ob.best_bid_amount = bid_amount;
 
+        auto [ask_price, ask_amount] = ob.asks.best_level();
+        ob.best_ask_price = ask_price;
+        ob.best_ask_amount = ask_amount;
     }
-}
\ No newline at end of file
+}
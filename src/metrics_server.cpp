@@ -0,0 +1,75 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#include "metrics_server.hpp"
+#include "metrics_text.hpp"
+#include "tsc_clock.hpp"
+#include <iostream>
+#include <sstream>
+
+namespace deribit {
+
+    using namespace metrics_text;
+
+    MetricsServer::~MetricsServer() {
+        stop();
+    }
+
+    bool MetricsServer::start() {
+        using namespace web::http;
+        try {
+            listener_ = std::make_unique<experimental::listener::http_listener>(
+                U("http://127.0.0.1:" + std::to_string(port_) + "/metrics"));
+            listener_->support(methods::GET, [this](http_request request) {
+                http_response response(status_codes::OK);
+                response.set_body(render(), "text/plain; version=0.0.4");
+                request.reply(response);
+            });
+            listener_->open().wait();
+        } catch (const std::exception& e) {
+            std::cout << "Metrics endpoint not started on port " << port_ << ": " << e.what() << std::endl;
+            listener_.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void MetricsServer::stop() {
+        if (!listener_) {
+            return;
+        }
+        try {
+            listener_->close().wait();
+        } catch (const std::exception& e) {
+            std::cout << "Metrics endpoint close error: " << e.what() << std::endl;
+        }
+        listener_.reset();
+    }
+
+    std::string MetricsServer::render() const {
+        std::ostringstream out;
+        out.precision(9);
+        render_market_data(out, market_data_);
+
+        const double seconds_per_tick = TscClock::ns_per_tick() * 1e-9;
+        if (orders_) {
+            header(out, "deribit_order_round_trip_seconds", "summary", "REST order request round trip.");
+            summary(out, "deribit_order_round_trip_seconds", "", orders_->round_trip().snapshot(), seconds_per_tick);
+            header(out, "deribit_order_request_errors_total", "counter", "REST order requests that failed or were rejected.");
+            sample(out, "deribit_order_request_errors_total", "", orders_->request_errors());
+            header(out, "deribit_order_queue_depth", "gauge", "Orders waiting for an async order worker.");
+            sample(out, "deribit_order_queue_depth", "", orders_->pending_orders());
+
+            header(out, "deribit_tick_to_trade_seconds", "summary",
+                   "Strategy orders from feed message to exchange ack, per segment "
+                   "(feed_to_decision, decision_to_send, send_to_ack, total).");
+            for (size_t i = 0; i < kTradeSegmentCount; ++i) {
+                TradeSegment segment = static_cast<TradeSegment>(i);
+                summary(out, "deribit_tick_to_trade_seconds", label("segment", to_label(segment)),
+                        orders_->tick_to_trade().histogram(segment).snapshot(), seconds_per_tick);
+            }
+        }
+        return out.str();
+    }
+}
@@ -0,0 +1,70 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#include "metrics_text.hpp"
+#include "tsc_clock.hpp"
+#include <vector>
+
+namespace deribit {
+    namespace metrics_text {
+
+        void render_market_data(std::ostream& out, const MarketData& market_data) {
+            const double seconds_per_tick = TscClock::ns_per_tick() * 1e-9;
+            const double seconds_per_ns = 1e-9;
+
+            header(out, "deribit_book_updates_total", "counter", "Book updates applied by the market data pipeline.");
+            sample(out, "deribit_book_updates_total", "", market_data.get_update_count());
+            header(out, "deribit_dropped_messages_total", "counter", "Book updates dropped on a full worker queue.");
+            sample(out, "deribit_dropped_messages_total", "", market_data.get_dropped_message_count());
+            header(out, "deribit_conflated_messages_total", "counter", "Book updates merged into a conflated update.");
+            sample(out, "deribit_conflated_messages_total", "", market_data.get_conflated_message_count());
+            header(out, "deribit_sequence_gaps_total", "counter", "Books that lost sequence and were flagged stale.");
+            sample(out, "deribit_sequence_gaps_total", "", market_data.get_gap_count());
+            header(out, "deribit_resyncs_total", "counter", "Books rebuilt from a snapshot after a gap.");
+            sample(out, "deribit_resyncs_total", "", market_data.get_resync_count());
+
+            std::vector<QueueMetrics> queues = market_data.queue_metrics();
+            header(out, "deribit_queue_depth", "gauge", "Book updates waiting in a worker queue.");
+            for (size_t i = 0; i < queues.size(); ++i) {
+                sample(out, "deribit_queue_depth", label("queue", std::to_string(i)), queues[i].depth);
+            }
+            header(out, "deribit_queue_high_water", "gauge", "Deepest backlog a worker has drained from its queue.");
+            for (size_t i = 0; i < queues.size(); ++i) {
+                sample(out, "deribit_queue_high_water", label("queue", std::to_string(i)), queues[i].high_water);
+            }
+            header(out, "deribit_queue_capacity", "gauge", "Slots in a worker queue.");
+            for (size_t i = 0; i < queues.size(); ++i) {
+                sample(out, "deribit_queue_capacity", label("queue", std::to_string(i)), queues[i].capacity);
+            }
+
+            header(out, "deribit_stage_latency_seconds", "summary",
+                   "Per-message latency of each pipeline stage (decode, queue_wait, apply, callback, total).");
+            const LatencyTracker& latency = market_data.latency();
+            for (size_t i = 0; i < kStageCount; ++i) {
+                Stage stage = static_cast<Stage>(i);
+                summary(out, "deribit_stage_latency_seconds", label("stage", to_label(stage)),
+                        latency.snapshot(stage), seconds_per_tick);
+            }
+
+            std::ostringstream messages;
+            std::ostringstream delay;
+            std::ostringstream jitter;
+            messages.precision(9);
+            delay.precision(9);
+            jitter.precision(9);
+            market_data.for_each_feed_timing([&](const std::string& name, const FeedTiming& timing) {
+                std::string labels = label("instrument", name);
+                sample(messages, "deribit_feed_messages_total", labels, timing.messages());
+                summary(delay, "deribit_feed_delay_seconds", labels, timing.delay().snapshot(), seconds_per_ns);
+                summary(jitter, "deribit_feed_jitter_seconds", labels, timing.jitter().snapshot(), seconds_per_ns);
+            });
+            header(out, "deribit_feed_messages_total", "counter", "Book messages received from the exchange.");
+            out << messages.str();
+            header(out, "deribit_feed_delay_seconds", "summary", "Local receive time minus exchange timestamp (ms resolution).");
+            out << delay.str();
+            header(out, "deribit_feed_jitter_seconds", "summary", "Change in feed delay between consecutive messages.");
+            out << jitter.str();
+        }
+    }
+}
@@ -3,23 +3,28 @@
 //
 
 #include "order.hpp"
+#include "thread_topology.hpp"
+#include "tsc_clock.hpp"
+#include "event_trace.hpp"
 #include <cpprest/json.h>
 #include <iostream>
 #include <chrono>
 
 namespace deribit {
 
-OrderManager::OrderManager(Config& config, size_t thread_pool_size, size_t buffer_capacity)
+OrderManager::OrderManager(Config& config, size_t thread_pool_size, size_t buffer_capacity,
+                           const WaitConfig& wait)
     : config_(config)
     , client_(config.BASE_URL)
+    , order_wait_(wait)
     , running_(false)
     , async_enabled_(false) {
     if (thread_pool_size > 0) {
-        order_buffer_ = std::make_unique<Buffer<OrderParams>>(buffer_capacity);
+        order_buffer_ = std::make_unique<Buffer<OrderParams, QueueMode::Mpmc>>(buffer_capacity);
         async_enabled_ = true;
         running_.store(true);
         for (size_t i = 0; i < thread_pool_size; ++i) {
-            workers_.emplace_back(&OrderManager::worker_thread, this);
+            workers_.emplace_back(&OrderManager::worker_thread, this, i);
         }
     }
 }
@@ -37,6 +42,22 @@ web::http::http_request OrderManager::create_authenticated_request(
     return request;
 }
 
+web::http::http_response OrderManager::send(const web::http::http_request& request) {
+    int64_t start = TscClock::now();
+    try {
+        web::http::http_response response = client_.request(request).get();
+        round_trip_.record_concurrent(static_cast<uint64_t>(TscClock::now() - start));
+        if (response.status_code() != web::http::status_codes::OK) {
+            request_errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return response;
+    } catch (...) {
+        round_trip_.record_concurrent(static_cast<uint64_t>(TscClock::now() - start));
+        request_errors_.fetch_add(1, std::memory_order_relaxed);
+        throw;
+    }
+}
+
 std::string OrderManager::place_buy_order(const OrderParams& params) {
     return place_buy_order_internal(params);
 }
@@ -50,7 +71,7 @@ bool OrderManager::cancel_order(const std::string& order_id) {
     builder.append_query("order_id", order_id);
     auto request = create_authenticated_request(web::http::methods::GET, builder.to_string());
     try {
-        auto response = client_.request(request).get();
+        auto response = send(request);
         return response.status_code() == web::http::status_codes::OK;
     } catch (const std::exception& e) {
         std::cout << "Cancel order error: " << e.what() << std::endl;
@@ -65,7 +86,7 @@ bool OrderManager::modify_order(const std::string& order_id, double new_amount,
         .append_query("price", new_price);
     auto request = create_authenticated_request(web::http::methods::GET, builder.to_string());
     try {
-        auto response = client_.request(request).get();
+        auto response = send(request);
         return response.status_code() == web::http::status_codes::OK;
     } catch (const std::exception& e) {
         std::cout << "Modify order error: " << e.what() << std::endl;
@@ -79,7 +100,7 @@ web::json::value OrderManager::get_positions(const std::string& currency, const
         .append_query("kind", kind);
     auto request = create_authenticated_request(web::http::methods::GET, builder.to_string());
     try {
-        auto response = client_.request(request).get();
+        auto response = send(request);
         if (response.status_code() == web::http::status_codes::OK) {
             return response.extract_json().get();
         }
@@ -99,7 +120,7 @@ std::string OrderManager::place_buy_order_internal(const OrderParams& params) {
     }
     auto request = create_authenticated_request(web::http::methods::GET, builder.to_string());
     try {
-        auto response = client_.request(request).get();
+        auto response = send(request);
         if (response.status_code() == web::http::status_codes::OK) {
             auto json = response.extract_json().get();
             return json["result"]["order"]["order_id"].as_string();
@@ -121,7 +142,7 @@ std::string OrderManager::place_sell_order_internal(const OrderParams& params) {
     builder.append_query("type", params.type);
     auto request = create_authenticated_request(web::http::methods::GET, builder.to_string());
     try {
-        auto response = client_.request(request).get();
+        auto response = send(request);
         if (response.status_code() == web::http::status_codes::OK) {
             auto json = response.extract_json().get();
             return json["result"]["order"]["order_id"].as_string();
@@ -136,14 +157,22 @@ bool OrderManager::submit_order_async(OrderParams&& order) {
     if (!async_enabled_ || !order_buffer_) {
         return false;
     }
-    return order_buffer_->push(order);
+    if (!order_buffer_->push(std::move(order))) {
+        return false;
+    }
+    order_wait_.notify();
+    return true;
 }
 
 bool OrderManager::submit_order_async(const OrderParams& order) {
     if (!async_enabled_ || !order_buffer_) {
         return false;
     }
-    return order_buffer_->push(order);
+    if (!order_buffer_->push(order)) {
+        return false;
+    }
+    order_wait_.notify();
+    return true;
 }
 
 std::future<std::string> OrderManager::submit_order_future(OrderParams order) {
@@ -165,7 +194,7 @@ void OrderManager::start_async_processing() {
     running_.store(true);
     size_t thread_count = 4;
     for (size_t i = 0; i < thread_count; ++i) {
-        workers_.emplace_back(&OrderManager::worker_thread, this);
+        workers_.emplace_back(&OrderManager::worker_thread, this, i);
     }
 }
 
@@ -174,6 +203,7 @@ void OrderManager::stop_async_processing() {
         return;
     }
     running_.store(false);
+    order_wait_.wake_all();
     for (auto& worker : workers_) {
         if (worker.joinable()) {
             worker.join();
@@ -182,17 +212,24 @@ void OrderManager::stop_async_processing() {
     workers_.clear();
 }
 
-void OrderManager::worker_thread() {
+void OrderManager::worker_thread(size_t index) {
+    ThreadTopology::global().pin_current_thread(ThreadRole::OrderSend, index, "order-" + std::to_string(index));
+    uint32_t idle_polls = 0;
     while (running_.load()) {
         if (!order_buffer_) {
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
-        auto order_opt = order_buffer_->pop();
-        if (order_opt) {
-            process_order(*order_opt);
+        // Fresh each time: try_pop swaps, so this leaves an empty OrderParams in
+        // the ring instead of the last order's callback and its captures.
+        OrderParams order;
+        if (order_buffer_->try_pop(order)) {
+            process_order(order);
+            idle_polls = 0;
         } else {
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            order_wait_.idle(idle_polls, [this] {
+                return !order_buffer_->empty() || !running_.load();
+            });
         }
     }
 }
@@ -200,6 +237,8 @@ void OrderManager::worker_thread() {
 void OrderManager::process_order(const OrderParams& params) {
     std::string order_id;
     bool success = false;
+    int64_t sent = TscClock::now();
+    EventTracer::record(TraceEvent::OrderSent, params.trace.id, 0, sent);
     try {
         if (params.side == "buy") {
             order_id = place_buy_order_internal(params);
@@ -213,13 +252,21 @@ void OrderManager::process_order(const OrderParams& params) {
         std::cout << "Async order processing error: " << e.what() << std::endl;
         success = false;
     }
+    int64_t acked = TscClock::now();
+    EventTracer::record(TraceEvent::OrderAcked, params.trace.id, success ? 1 : 0, acked);
+    if (success) {
+        tick_to_trade_.record(params.trace, sent, acked);
+        if (params.trace.receive_ticks) {
+            EventTracer::check(acked - params.trace.receive_ticks);
+        }
+    }
     if (params.callback) {
         params.callback(order_id, success);
     }
 }
 
 size_t OrderManager::pending_orders() const {
-    return 0;
+    return order_buffer_ ? order_buffer_->size() : 0;
 }
 
 bool OrderManager::is_async_running() const {
@@ -0,0 +1,110 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#include "snapshot_fetcher.hpp"
+#include <iostream>
+
+namespace deribit {
+
+    namespace {
+        // REST levels are plain [price, amount] pairs.
+        void read_levels(const web::json::value& levels, std::vector<BookLevel>& out) {
+            if (!levels.is_array()) {
+                return;
+            }
+            for (const auto& level : levels.as_array()) {
+                const auto& pair = level.as_array();
+                if (pair.size() < 2) {
+                    continue;
+                }
+                BookLevel parsed;
+                parsed.action = LevelAction::New;
+                parsed.price = pair.at(0).as_double();
+                parsed.amount = pair.at(1).as_double();
+                out.push_back(parsed);
+            }
+        }
+    }
+
+    SnapshotFetcher::SnapshotFetcher(Config& config, MarketData& market_data, int depth)
+        : market_data_(market_data)
+        , client_(config.BASE_URL)
+        , depth_(depth) {
+        market_data_.set_resync_handler([this](InstrumentId id, const std::string& symbol) {
+            request(id, symbol);
+        });
+    }
+
+    SnapshotFetcher::~SnapshotFetcher() {
+        market_data_.set_resync_handler(nullptr);
+
+        std::unique_lock<std::mutex> lock(in_flight_mutex_);
+        in_flight_cv_.wait(lock, [this] { return in_flight_ == 0; });
+    }
+
+    void SnapshotFetcher::request(InstrumentId id, const std::string& symbol) {
+        web::uri_builder builder("/public/get_order_book");
+        builder.append_query("instrument_name", symbol)
+            .append_query("depth", depth_);
+
+        {
+            std::lock_guard<std::mutex> lock(in_flight_mutex_);
+            ++in_flight_;
+        }
+
+        client_.request(web::http::methods::GET, builder.to_string())
+            .then([](web::http::http_response response) {
+                if (response.status_code() != web::http::status_codes::OK) {
+                    throw std::runtime_error("HTTP " + std::to_string(response.status_code()));
+                }
+                return response.extract_json();
+            })
+            .then([this, id, symbol](pplx::task<web::json::value> task) {
+                try {
+                    BookUpdate snapshot;
+                    if (to_snapshot(task.get(), id, snapshot)) {
+                        market_data_.submit_snapshot(std::move(snapshot));
+                    } else {
+                        std::cout << "Unexpected order book response for " << symbol << std::endl;
+                    }
+                } catch (const std::exception& e) {
+                    // MarketData asks again if the book is still stale a while later.
+                    std::cout << "Snapshot request failed for " << symbol << ": " << e.what() << std::endl;
+                }
+                finish_request();
+            });
+    }
+
+    bool SnapshotFetcher::to_snapshot(const web::json::value& response, InstrumentId id, BookUpdate& out) {
+        if (!response.has_field("result")) {
+            return false;
+        }
+        const auto& result = response.at("result");
+        if (!result.has_field("change_id")) {
+            return false;
+        }
+
+        out.clear();
+        out.instrument_id = id;
+        out.type = BookUpdateType::Snapshot;
+        out.change_id = result.at("change_id").as_number().to_int64();
+        if (result.has_field("timestamp")) {
+            out.timestamp = result.at("timestamp").as_number().to_int64();
+        }
+        if (result.has_field("bids")) {
+            read_levels(result.at("bids"), out.bids);
+        }
+        if (result.has_field("asks")) {
+            read_levels(result.at("asks"), out.asks);
+        }
+        return true;
+    }
+
+    void SnapshotFetcher::finish_request() {
+        std::lock_guard<std::mutex> lock(in_flight_mutex_);
+        if (--in_flight_ == 0) {
+            in_flight_cv_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,139 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#include "thread_topology.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace deribit {
+
+    const char* to_string(ThreadRole role) {
+        switch (role) {
+            case ThreadRole::Io: return "io";
+            case ThreadRole::BookShard: return "book-shard";
+            case ThreadRole::OrderSend: return "order-send";
+        }
+        return "unknown";
+    }
+
+    void ThreadTopology::configure(const Config::Threading& threading) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        threading_ = threading;
+    }
+
+    const std::vector<int>& ThreadTopology::cores(ThreadRole role) const {
+        switch (role) {
+            case ThreadRole::Io: return threading_.io_cores;
+            case ThreadRole::BookShard: return threading_.shard_cores;
+            case ThreadRole::OrderSend: return threading_.order_cores;
+        }
+        return threading_.io_cores;
+    }
+
+    int ThreadTopology::core_for(ThreadRole role, size_t index) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const std::vector<int>& list = cores(role);
+        return list.empty() ? -1 : list[index % list.size()];
+    }
+
+    int ThreadTopology::numa_node_of_core(int core) {
+#if defined(__linux__)
+        if (core < 0) {
+            return -1;
+        }
+        // /sys/devices/system/cpu/cpuN/nodeM exists for the core's node.
+        std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(core);
+        DIR* dir = opendir(path.c_str());
+        if (!dir) {
+            return -1;
+        }
+        int node = -1;
+        while (dirent* entry = readdir(dir)) {
+            if (std::strncmp(entry->d_name, "node", 4) == 0) {
+                node = std::atoi(entry->d_name + 4);
+                break;
+            }
+        }
+        closedir(dir);
+        return node;
+#else
+        (void)core;
+        return -1;
+#endif
+    }
+
+    int ThreadTopology::pin_current_thread(ThreadRole role, size_t index, const std::string& name) {
+        int core = core_for(role, index);
+        Placement placement{name, role, core, -1, false, ""};
+
+#if defined(__linux__)
+        std::string short_name = name.substr(0, 15);
+        pthread_setname_np(pthread_self(), short_name.c_str());
+
+        if (core >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(core, &set);
+            int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            if (rc != 0) {
+                placement.note = std::string("affinity failed: ") + std::strerror(rc);
+                placement.core = -1;
+            } else {
+                placement.numa_node = numa_node_of_core(core);
+            }
+        }
+
+        int priority = threading_.realtime_priority;
+        if (priority > 0) {
+            sched_param param{};
+            param.sched_priority = priority;
+            int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (rc == 0) {
+                placement.realtime = true;
+            } else {
+                // Usually EPERM without CAP_SYS_NICE / rtprio limits; keep running at normal priority.
+                if (!placement.note.empty()) placement.note += "; ";
+                placement.note += std::string("SCHED_FIFO failed: ") + std::strerror(rc);
+            }
+        }
+#else
+        (void)role;
+        (void)index;
+        placement.note = "pinning not supported on this platform";
+#endif
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        placements_.push_back(std::move(placement));
+        return placements_.back().core;
+    }
+
+    void ThreadTopology::print_report(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        out << "\n" << std::string(60, '=') << std::endl;
+        out << "THREAD LAYOUT" << std::endl;
+        out << std::string(60, '=') << std::endl;
+        out << std::left << std::setw(16) << "Thread" << std::setw(12) << "Role"
+            << std::setw(8) << "Core" << std::setw(8) << "Node" << "Sched" << std::endl;
+        for (const Placement& p : placements_) {
+            out << std::setw(16) << p.name << std::setw(12) << to_string(p.role)
+                << std::setw(8) << (p.core >= 0 ? std::to_string(p.core) : "any")
+                << std::setw(8) << (p.numa_node >= 0 ? std::to_string(p.numa_node) : "-")
+                << (p.realtime ? "FIFO" : "normal");
+            if (!p.note.empty()) {
+                out << "  (" << p.note << ")";
+            }
+            out << std::endl;
+        }
+        out << std::right << std::string(60, '=') << std::endl;
+    }
+}
@@ -0,0 +1,186 @@
+//
+// Created by Supradeep Chitumalla
+//
+
+#include "warmup.hpp"
+#include "book_decoder.hpp"
+#include "memory_prefault.hpp"
+#include "synthetic_feed.hpp"
+#include "thread_topology.hpp"
+#include "tsc_clock.hpp"
+#include "wait_strategy.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace deribit {
+
+    namespace {
+        constexpr std::chrono::seconds kCallbackTimeout{1};
+
+        // What the update callback shares with the feeding thread. Owned through
+        // a shared_ptr so that a callback arriving after its wait timed out
+        // still has something valid to write to.
+        struct Probe {
+            OrderBookUpdateCallback strategy;
+            std::atomic<uint64_t> delivered{0};
+            std::atomic<int64_t> delivered_at{0};      // TscClock ticks
+        };
+
+        bool wait_for_delivery(const Probe& probe, uint64_t expected) {
+            auto deadline = std::chrono::steady_clock::now() + kCallbackTimeout;
+            uint32_t spins = 0;
+            while (probe.delivered.load(std::memory_order_acquire) < expected) {
+                if (++spins < 64) {
+                    cpu_relax();
+                } else if (std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::yield();
+                } else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // `samples` are in TscClock ticks.
+        WarmupWindow summarize(std::vector<int64_t>& samples, size_t updates) {
+            std::sort(samples.begin(), samples.end());
+            WarmupWindow window;
+            window.updates = updates;
+            window.p50_ns = TscClock::to_ns(samples[(samples.size() - 1) / 2]);
+            window.p99_ns = TscClock::to_ns(samples[static_cast<size_t>(0.99 * static_cast<double>(samples.size() - 1))]);
+            window.max_ns = TscClock::to_ns(samples.back());
+            return window;
+        }
+
+        // Three consecutive window medians within `tolerance` of the lowest.
+        bool settled(const std::vector<WarmupWindow>& windows, double tolerance) {
+            if (windows.size() < 3) {
+                return false;
+            }
+            int64_t lo = windows.back().p50_ns;
+            int64_t hi = lo;
+            for (auto it = windows.end() - 3; it != windows.end(); ++it) {
+                lo = std::min(lo, it->p50_ns);
+                hi = std::max(hi, it->p50_ns);
+            }
+            return lo > 0 && static_cast<double>(hi - lo) <= tolerance * static_cast<double>(lo);
+        }
+
+        // Frame by frame, each one waited for, so what is measured is the path
+        // itself rather than queueing behind earlier frames.
+        void feed_frames(MarketData& market_data, const Config::Warmup& config,
+                         const std::vector<RecordedFrame>& frames, Probe& probe, WarmupReport& report) {
+            BookDecoder decoder(&market_data.instruments());
+            BookUpdate update;
+            const size_t window = std::max<size_t>(config.window, 1);
+            std::vector<int64_t> samples;
+            samples.reserve(window);
+            uint64_t sent = 0;
+
+            for (const RecordedFrame& frame : frames) {
+                int64_t start = TscClock::now();
+                if (decoder.decode(frame.payload, update) != DecodeStatus::Book) {
+                    continue;
+                }
+                update.receive_ticks = start;
+                market_data.enqueue_orderbook_update(update);
+                ++sent;
+                if (!wait_for_delivery(probe, sent - report.lost)) {
+                    ++report.lost;
+                    continue;
+                }
+                samples.push_back(probe.delivered_at.load(std::memory_order_relaxed) - start);
+
+                if (samples.size() == window) {
+                    report.windows.push_back(summarize(samples, static_cast<size_t>(sent)));
+                    samples.clear();
+                    if (settled(report.windows, config.tolerance)) {
+                        report.steady = true;
+                        break;
+                    }
+                }
+            }
+            report.updates = static_cast<size_t>(sent);
+        }
+
+        std::string format_us(int64_t ns) {
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(1) << static_cast<double>(ns) / 1000.0 << " us";
+            return out.str();
+        }
+
+        void print_window(const char* label, const WarmupWindow& window) {
+            std::cout << "  " << std::left << std::setw(8) << label << std::right
+                      << "p50 " << std::setw(10) << format_us(window.p50_ns)
+                      << "  p99 " << std::setw(10) << format_us(window.p99_ns)
+                      << "  max " << std::setw(10) << format_us(window.max_ns) << std::endl;
+        }
+    }
+
+    WarmupReport Warmup::run(OrderBookUpdateCallback strategy) {
+        WarmupReport report;
+        std::cout << "Warming up the market data path..." << std::endl;
+
+        if (config_.lock_memory) {
+            report.memory_locked = lock_all_memory();
+            std::cout << (report.memory_locked
+                ? "  Memory locked (current and future mappings)"
+                : "  mlockall failed; needs CAP_IPC_LOCK or a higher RLIMIT_MEMLOCK") << std::endl;
+        }
+        market_data_.prepare_memory(config_.huge_pages, config_.reserve_levels);
+
+        // Enough instruments that every shard gets some of them.
+        SyntheticFeedOptions options;
+        options.name_prefix = "WARMUP";
+        options.instruments = std::max<size_t>(4, 2 * market_data_.shard_count());
+        options.updates = config_.max_updates;
+        SyntheticFeed feed(options);
+        std::vector<RecordedFrame> frames = feed.generate();
+        for (size_t i = 0; i < options.instruments; ++i) {
+            market_data_.exclude_from_reports(market_data_.register_instrument(feed.instrument_name(i)));
+        }
+
+        auto probe = std::make_shared<Probe>();
+        probe->strategy = strategy;
+        market_data_.set_update_callback([probe](const std::string& symbol, const Orderbook& ob) {
+            if (probe->strategy) {
+                probe->strategy(symbol, ob);
+            }
+            probe->delivered_at.store(TscClock::now(), std::memory_order_relaxed);
+            probe->delivered.fetch_add(1, std::memory_order_release);
+        });
+
+        // Same core as the WebSocket thread, so its predictors and caches warm up.
+        std::thread feeder([&] {
+            ThreadTopology::global().pin_current_thread(ThreadRole::Io, 0, "warmup");
+            feed_frames(market_data_, config_, frames, *probe, report);
+        });
+        feeder.join();
+
+        // The warm-up is slow by design; it must not show up as live latency.
+        market_data_.restart_stats();
+
+        // A lost callback may still turn up; leave the probe (which forwards to
+        // the strategy anyway) in place rather than swap it under a worker.
+        if (report.lost == 0) {
+            market_data_.set_update_callback(std::move(strategy));
+        }
+
+        std::cout << "Warm-up: " << report.updates << " synthetic updates, "
+                  << (report.steady ? "steady" : "not yet steady") << std::endl;
+        if (!report.windows.empty()) {
+            print_window("first", report.windows.front());
+            print_window("last", report.windows.back());
+        }
+        if (report.lost > 0) {
+            std::cout << "  " << report.lost << " updates never reached the callback" << std::endl;
+        }
+        return report;
+    }
+}
@@ -0,0 +1,82 @@
+//
+// Created by Supradeep Chitumalla
+//
+// A local Deribit market data endpoint for running the trading client
+// without testnet. Set "ws_url" in config.json to the printed URL and
+// subscribe to instruments in the corpus (SYN0-PERPETUAL ... for the
+// synthetic one).
+//
+// usage: feed_simulator [recording.rec] [--port N] [--rate R] [--burst N]
+//                       [--frames N] [--tls cert.pem key.pem]
+//
+// Without a recording a synthetic feed is generated. Once a client has
+// subscribed the corpus is streamed to it at --rate frames/s (0 = as fast
+// as the socket takes them) in bursts of --burst frames, then the simulator
+// waits for the next client. A self-signed pair for --tls:
+//
+//   openssl req -x509 -newkey rsa:2048 -nodes -subj /CN=localhost -days 365 -keyout key.pem -out cert.pem
+
+#include "feed_simulator.hpp"
+#include "synthetic_feed.hpp"
+#include "tsc_clock.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+
+using namespace deribit;
+
+int main(int argc, char** argv) {
+    std::string recording;
+    FeedSimulatorOptions options;
+    StreamProfile profile;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            options.port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (std::strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            profile.rate = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--burst") == 0 && i + 1 < argc) {
+            profile.burst = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            profile.frames = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--tls") == 0 && i + 2 < argc) {
+            options.cert_file = argv[++i];
+            options.key_file = argv[++i];
+        } else if (argv[i][0] == '-') {
+            std::fprintf(stderr, "usage: %s [recording.rec] [--port N] [--rate R] [--burst N] [--frames N] "
+                                 "[--tls cert.pem key.pem]\n", argv[0]);
+            return 1;
+        } else {
+            recording = argv[i];
+        }
+    }
+
+    TscClock::calibrate();
+    try {
+        FeedSimulator simulator(recording.empty() ? SyntheticFeed().generate() : load_recording(recording), options);
+        simulator.start();
+        for (;;) {
+            simulator.wait_for_subscriptions(1, std::numeric_limits<int32_t>::max());
+            // Give the client a moment to subscribe to the rest of its instruments.
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            std::printf("streaming to %zu subscription(s)\n", simulator.subscriptions());
+
+            StreamResult r = simulator.stream(profile);
+            std::printf("%zu frames in %.3f s (%.0f frames/s), %zu sent, %zu send errors, %zu stalls\n",
+                        r.frames, static_cast<double>(r.elapsed_ns) / 1e9, r.frames_per_second(), r.sent,
+                        r.send_errors, r.stalls);
+            std::fflush(stdout);
+
+            while (simulator.subscriptions() > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
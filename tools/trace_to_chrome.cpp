@@ -0,0 +1,188 @@
+//
+// Created by Supradeep Chitumalla
+//
+// Converts an EventTracer dump to the Chrome trace event JSON that
+// chrome://tracing and ui.perfetto.dev open.
+//
+// usage: trace_to_chrome <trace.bin> [out.json]
+//
+// Every thread that recorded becomes a track. Begin/end events on a thread
+// become slices (received -> enqueued is "decode", dequeued -> applied is
+// "apply", order_sent -> order_acked is "order"); anything unpaired is an
+// instant event. Slices of the same feed message are joined across threads
+// by flow arrows, so one message can be followed from the IO thread through
+// a book worker to the order worker that acted on it.
+
+#include "event_trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace deribit;
+
+namespace {
+
+    struct Slice {
+        const char* name;
+        size_t tid;
+        int64_t start;
+        int64_t end;        // == start for an instant event
+        uint64_t trace_id;
+        uint32_t arg;
+        bool instant;
+    };
+
+    // Whether `end` closes a slice opened by `begin`, and the slice name.
+    bool closes(TraceEvent begin, TraceEvent end, const char** name) {
+        if (begin == TraceEvent::Received && end == TraceEvent::Enqueued) {
+            *name = "decode";
+        } else if (begin == TraceEvent::Dequeued && end == TraceEvent::Applied) {
+            *name = "apply";
+        } else if (begin == TraceEvent::OrderSent && end == TraceEvent::OrderAcked) {
+            *name = "order";
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    bool opens(TraceEvent event) {
+        return event == TraceEvent::Received || event == TraceEvent::Dequeued || event == TraceEvent::OrderSent;
+    }
+
+    // Begins are kept on a stack so that slices may nest: in RoutingMode::Inline
+    // the IO thread applies the message between receiving and enqueueing it.
+    std::vector<Slice> slices_of(const TraceDump::Thread& thread, size_t tid) {
+        std::vector<Slice> out;
+        std::vector<const TraceRecord*> open;
+        auto instant = [&out, tid](const TraceRecord& r) {
+            out.push_back({to_string(r.event), tid, r.ticks, r.ticks, r.trace_id, r.arg, true});
+        };
+        for (const TraceRecord& r : thread.records) {
+            if (opens(r.event)) {
+                open.push_back(&r);
+                continue;
+            }
+            const char* name = nullptr;
+            auto begin = std::find_if(open.rbegin(), open.rend(), [&r, &name](const TraceRecord* b) {
+                return b->trace_id == r.trace_id && closes(b->event, r.event, &name);
+            });
+            if (begin == open.rend()) {
+                instant(r);
+                continue;
+            }
+            out.push_back({name, tid, (*begin)->ticks, r.ticks, r.trace_id, (*begin)->arg, false});
+            // Begins above it never got their end (the ring wrapped, or an exception).
+            for (auto it = open.rbegin(); it != begin; ++it) {
+                instant(**it);
+            }
+            open.erase(std::prev(begin.base()), open.end());
+        }
+        for (const TraceRecord* r : open) {
+            instant(*r);
+        }
+        return out;
+    }
+
+    // JSON string body; thread names are the only free text.
+    std::string escape(const std::string& s) {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            if (static_cast<unsigned char>(c) >= 0x20) {
+                out += c;
+            }
+        }
+        return out;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <trace.bin> [out.json]\n", argv[0]);
+        return 1;
+    }
+    std::string input = argv[1];
+    std::string output = argc > 2 ? argv[2] : input + ".json";
+
+    TraceDump dump;
+    try {
+        dump = load_trace(input);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    std::vector<Slice> slices;
+    for (size_t t = 0; t < dump.threads.size(); ++t) {
+        std::vector<Slice> thread = slices_of(dump.threads[t], t + 1);
+        slices.insert(slices.end(), thread.begin(), thread.end());
+    }
+    if (slices.empty()) {
+        std::fprintf(stderr, "%s: no events\n", input.c_str());
+        return 1;
+    }
+    int64_t origin = std::min_element(slices.begin(), slices.end(), [](const Slice& a, const Slice& b) {
+        return a.start < b.start;
+    })->start;
+    auto us = [&dump, origin](int64_t ticks) {
+        return static_cast<double>(ticks - origin) * dump.ns_per_tick / 1000.0;
+    };
+
+    FILE* out = std::fopen(output.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "Failed to open %s\n", output.c_str());
+        return 1;
+    }
+    std::fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    std::fprintf(out, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"trading\"}}");
+    for (size_t t = 0; t < dump.threads.size(); ++t) {
+        std::fprintf(out, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}}",
+                     t + 1, escape(dump.threads[t].name).c_str());
+    }
+
+    std::map<uint64_t, std::vector<const Slice*>> flows;
+    for (const Slice& s : slices) {
+        if (s.instant) {
+            std::fprintf(out, ",\n{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"name\":\"%s\","
+                              "\"args\":{\"trace_id\":%llu,\"arg\":%u}}",
+                         s.tid, us(s.start), s.name, static_cast<unsigned long long>(s.trace_id), s.arg);
+            continue;
+        }
+        std::fprintf(out, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f,\"name\":\"%s\","
+                          "\"args\":{\"trace_id\":%llu,\"arg\":%u}}",
+                     s.tid, us(s.start), us(s.end) - us(s.start), s.name,
+                     static_cast<unsigned long long>(s.trace_id), s.arg);
+        if (s.trace_id != 0) {
+            flows[s.trace_id].push_back(&s);
+        }
+    }
+
+    size_t arrows = 0;
+    for (auto& [id, steps] : flows) {
+        if (steps.size() < 2) {
+            continue;
+        }
+        std::sort(steps.begin(), steps.end(), [](const Slice* a, const Slice* b) { return a->start < b->start; });
+        for (size_t i = 0; i < steps.size(); ++i) {
+            const char* phase = i == 0 ? "s" : i + 1 == steps.size() ? "f" : "t";
+            std::fprintf(out, ",\n{\"ph\":\"%s\",%s\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"id\":%llu,"
+                              "\"cat\":\"message\",\"name\":\"message\"}",
+                         phase, i + 1 == steps.size() ? "\"bp\":\"e\"," : "", steps[i]->tid, us(steps[i]->start),
+                         static_cast<unsigned long long>(id));
+        }
+        ++arrows;
+    }
+    std::fprintf(out, "\n]}\n");
+    std::fclose(out);
+
+    std::printf("%s: %zu threads, %zu slices and instants, %zu traced messages -> %s\n", input.c_str(),
+                dump.threads.size(), slices.size(), arrows, output.c_str());
+    return 0;
+}